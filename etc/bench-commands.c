@@ -0,0 +1,116 @@
+/* bench-commands.c -- https://github.com/takeiteasy/fun-with-triangles
+
+ fun-with-triangles
+
+ Copyright (C) 2025  George Watson
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <https://www.gnu.org/licenses/>. */
+
+// Records and replays 1M commands through the command queue on the dummy backend,
+// then compares sokol_gp draw calls for an unsorted and a sorted blend-mode thrash.
+// Build with `make bench-commands`, run it against two revisions to compare.
+
+#include "fwt.c"
+
+#if !defined(BENCH_COMMANDS)
+#define BENCH_COMMANDS 1000000
+#endif
+
+// Commands replayed between sgp_begin/sgp_end, keeps sokol_gp under its default limits
+#if !defined(BENCH_BATCH)
+#define BENCH_BATCH 4000
+#endif
+
+static void RecordBatch(int offset) {
+    for (int i = 0; i < BENCH_BATCH; i += 8) {
+        float t = (float)(offset + i) / BENCH_COMMANDS;
+        fwtPushTransform(&state);
+        fwtTranslate(&state, t, -t);
+        fwtRotate(&state, t * 3.14f);
+        fwtSetColor(&state, t, 1.f - t, .5f, 1.f);
+        fwtDrawFilledRect(&state, -.5f, -.5f, 1.f, 1.f);
+        fwtDrawLine(&state, -1.f, -1.f, 1.f, 1.f);
+        fwtResetColor(&state);
+        fwtPopTransform(&state);
+    }
+}
+
+#if !defined(BENCH_SORT_ITEMS)
+#define BENCH_SORT_ITEMS 2000
+#endif
+
+// Alternating blend modes defeat sokol_gp's batch optimizer, sorting should bring it back to 2 draws
+static void RecordBlendThrash(bool sorted) {
+    if (sorted)
+        fwtBeginSortedDraws(&state);
+    for (int i = 0; i < BENCH_SORT_ITEMS; i++) {
+        float t = (float)i / BENCH_SORT_ITEMS;
+        if (sorted)
+            fwtSetLayer(&state, 0);
+        fwtSetBlendMode(&state, i % 2 ? SGP_BLENDMODE_BLEND : SGP_BLENDMODE_ADD);
+        fwtDrawFilledRect(&state, t * 2.f - 1.f, t * 2.f - 1.f, .1f, .1f);
+    }
+    if (sorted)
+        fwtEndSortedDraws(&state);
+}
+
+static uint32_t CountDrawCalls(bool sorted) {
+    sgp_begin(DEFAULT_WINDOW_WIDTH, DEFAULT_WINDOW_HEIGHT);
+    RecordBlendThrash(sorted);
+    ProcessCommandQueue();
+    uint32_t result = _sgp.cur_command;
+    sg_begin_default_pass(&state.pass_action, DEFAULT_WINDOW_WIDTH, DEFAULT_WINDOW_HEIGHT);
+    sgp_flush();
+    sgp_end();
+    sg_end_pass();
+    sg_commit();
+    ResetCommandQueue();
+    return result;
+}
+
+int main(int argc, char *argv[]) {
+    sg_setup(&(sg_desc){0});
+    stm_setup();
+    sgp_setup(&(sgp_desc){0});
+    assert(sg_isvalid() && sgp_is_valid());
+
+    uint64_t recordTime = 0, replayTime = 0;
+    for (int i = 0; i < BENCH_COMMANDS; i += BENCH_BATCH) {
+        uint64_t start = stm_now();
+        RecordBatch(i);
+        recordTime += stm_since(start);
+
+        sgp_begin(DEFAULT_WINDOW_WIDTH, DEFAULT_WINDOW_HEIGHT);
+        start = stm_now();
+        ProcessCommandQueue();
+        replayTime += stm_since(start);
+        sg_begin_default_pass(&state.pass_action, DEFAULT_WINDOW_WIDTH, DEFAULT_WINDOW_HEIGHT);
+        sgp_flush();
+        sgp_end();
+        sg_end_pass();
+        sg_commit();
+        ResetCommandQueue();
+    }
+
+    printf("commands: %d\n", BENCH_COMMANDS);
+    printf("record:   %.2f ns/command\n", stm_ns(recordTime) / BENCH_COMMANDS);
+    printf("replay:   %.2f ns/command\n", stm_ns(replayTime) / BENCH_COMMANDS);
+    printf("draw calls (%d interleaved blend modes): %u unsorted, %u sorted\n",
+           BENCH_SORT_ITEMS, CountDrawCalls(false), CountDrawCalls(true));
+
+    free(state.commandBuffer.data);
+    sgp_shutdown();
+    sg_shutdown();
+    return 0;
+}
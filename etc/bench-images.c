@@ -0,0 +1,179 @@
+/* bench-images.c -- https://github.com/takeiteasy/fun-with-triangles
+
+ fun-with-triangles
+
+ Copyright (C) 2025  George Watson
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <https://www.gnu.org/licenses/>. */
+
+// Decodes every .png in a directory (FWT_ASSETS_PATH by default) through LoadImage and
+// reports MB/s of decoded pixels, next to the old column-major repack and the swizzle alone.
+// When FWT_ASSETS_PACK_PATH exists (`make assets`) it also compares the time to create every
+// texture from the decoded files against creating them from the mapped pack.
+// Build with `make bench-images`, add -DFWT_TEXTURE_BGRA to BENCHFLAGS to include the swizzle.
+
+#include "fwt.c"
+
+#if !defined(BENCH_IMAGE_PASSES)
+#define BENCH_IMAGE_PASSES 10
+#endif
+
+// The per-pixel repack LoadImage used to do, kept here as the baseline
+static int* RepackImage(unsigned char *in, int w, int h) {
+    int *buf = malloc(w * h * sizeof(int));
+    for (int x = 0; x < w; x++)
+        for (int y = 0; y < h; y++) {
+            unsigned char *p = in + (x + w * y) * 4;
+            buf[y * w + x] = (p[3] << 24) | (p[0] << 16) | (p[1] << 8) | p[2];
+        }
+    return buf;
+}
+
+static bool IsPNG(const char *name) {
+    size_t length = strlen(name);
+    if (length <= 4)
+        return false;
+    const char *ext = name + length - 4;
+    return ext[0] == '.' && tolower(ext[1]) == 'p' && tolower(ext[2]) == 'n' && tolower(ext[3]) == 'g';
+}
+
+// Startup without a pack: read, decode and upload every image
+static uint64_t DecodeStartup(const char *path, int *count) {
+    static fwtTexture textures[1024];
+    *count = 0;
+    uint64_t start = stm_now();
+    DIR *dir = opendir(path);
+    char full[MAX_PATH];
+    struct dirent *ent;
+    while ((ent = readdir(dir)) && *count < 1024) {
+        if (!IsPNG(ent->d_name))
+            continue;
+        snprintf(full, MAX_PATH, "%s/%s", path, ent->d_name);
+        size_t size = 0;
+        int w, h;
+        unsigned char *data = (unsigned char*)LoadFile(full, &size);
+        if (!data)
+            continue;
+        int *pixels = LoadImage(data, (int)size, &w, &h);
+        if (!pixels) {
+            free(data);
+            continue;
+        }
+        textures[(*count)++] = ImmutableTexture(pixels, w, h);
+        free(pixels);
+        free(data);
+    }
+    closedir(dir);
+    uint64_t result = stm_since(start);
+    for (int i = 0; i < *count; i++)
+        DestroyTexture(&textures[i]);
+    return result;
+}
+
+static uint64_t PackStartup(int *count) {
+    static fwtTexture textures[1024];
+    fwtTexturePack pack;
+    uint64_t start = stm_now();
+    if (!OpenTexturePack(&pack, FWT_ASSETS_PACK_PATH)) {
+        *count = 0;
+        return 0;
+    }
+    *count = pack.count < 1024 ? pack.count : 1024;
+    for (int i = 0; i < *count; i++)
+        textures[i] = PackedTexture(&pack, &pack.entries[i]);
+    uint64_t result = stm_since(start);
+    for (int i = 0; i < *count; i++)
+        DestroyTexture(&textures[i]);
+    CloseTexturePack(&pack);
+    return result;
+}
+
+int main(int argc, char *argv[]) {
+#if defined(FWT_ASSETS_PATH)
+    const char *path = argc > 1 ? argv[1] : FWT_ASSETS_PATH;
+#else
+    assert(argc > 1);
+    const char *path = argv[1];
+#endif
+    stm_setup();
+    sg_setup(&(sg_desc){0});
+    assert(sg_isvalid());
+
+    DIR *dir = opendir(path);
+    if (!dir) {
+        fprintf(stderr, "Failed to open \"%s\"\n", path);
+        return 1;
+    }
+
+    int images = 0;
+    double bytes = 0;
+    uint64_t loadTime = 0, repackTime = 0, swizzleTime = 0;
+    char full[MAX_PATH];
+    struct dirent *ent;
+    while ((ent = readdir(dir))) {
+        if (!IsPNG(ent->d_name))
+            continue;
+        snprintf(full, MAX_PATH, "%s/%s", path, ent->d_name);
+        size_t size = 0;
+        int w, h;
+        unsigned char *data = (unsigned char*)LoadFile(full, &size);
+        if (!data)
+            continue;
+
+        for (int i = 0; i < BENCH_IMAGE_PASSES; i++) {
+            uint64_t start = stm_now();
+            int *pixels = LoadImage(data, (int)size, &w, &h);
+            loadTime += stm_since(start);
+            if (!pixels)
+                break;
+
+            // Decode cost is identical for both paths, so only the extra pass is compared
+            start = stm_now();
+            int *repacked = RepackImage((unsigned char*)pixels, w, h);
+            repackTime += stm_since(start);
+            start = stm_now();
+            SwizzleRGBA((unsigned char*)pixels, (size_t)w * h);
+            swizzleTime += stm_since(start);
+
+            free(repacked);
+            free(pixels);
+            bytes += (double)w * h * 4;
+        }
+        free(data);
+        images++;
+    }
+    closedir(dir);
+
+    if (!images) {
+        fprintf(stderr, "No .png files in \"%s\"\n", path);
+        return 1;
+    }
+    double mb = bytes / (1024. * 1024.);
+    printf("images:  %d x %d passes, %.2f MB decoded\n", images, BENCH_IMAGE_PASSES, mb);
+    printf("load:    %.2f MB/s\n", mb / stm_sec(loadTime));
+    printf("repack:  %.2f MB/s (old column-major copy)\n", mb / stm_sec(repackTime));
+    printf("swizzle: %.2f MB/s (in place)\n", mb / stm_sec(swizzleTime));
+
+    // The page cache is warm by now, so this compares CPU work rather than disk reads
+    int decoded = 0, packed = 0;
+    uint64_t decodeStartup = DecodeStartup(path, &decoded);
+    uint64_t packStartup = PackStartup(&packed);
+    printf("startup: %.2f ms decoding %d images\n", stm_ms(decodeStartup), decoded);
+    if (packed)
+        printf("startup: %.2f ms from \"%s\" (%d images)\n", stm_ms(packStartup), FWT_ASSETS_PACK_PATH, packed);
+    else
+        printf("startup: no pack at \"%s\", run `make assets`\n", FWT_ASSETS_PACK_PATH);
+    sg_shutdown();
+    return 0;
+}
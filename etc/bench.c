@@ -0,0 +1,205 @@
+/* bench.c -- https://github.com/takeiteasy/fun-with-triangles
+
+ fun-with-triangles
+
+ Copyright (C) 2025  George Watson
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <https://www.gnu.org/licenses/>. */
+
+// Runs a scene through InitCallback/FrameCallback on the dummy backend (no window, no GPU) for a
+// fixed number of frames at a fixed delta, and writes per-phase timings as JSON. The timings come
+// from the profiler scopes FrameCallback already has, read back after every frame.
+// Build the scenes and the harness with `make scenes bench`, then for example:
+//   ./build/bench scene=example frames=1000 delta=0.016667 out=bench.json
+// Input recorded with `recordInput=<file>` (in the program or here) is fed back with `replayInput=<file>`
+
+#include "fwt.c"
+
+#if defined(FWT_RELEASE)
+#error The benchmark reads its timings from the profiler, build it without FWT_RELEASE
+#endif
+
+// Scene run when no scene= is passed, the program's first scene unless overridden
+#if !defined(BENCH_DEFAULT_SCENE)
+#define BENCH_DEFAULT_SCENE FWT_FIRST_SCENE
+#endif
+
+#if !defined(BENCH_FRAMES)
+#define BENCH_FRAMES 1000
+#endif
+
+// Frames run before measuring, lets caches, allocators and the texture loader settle
+#if !defined(BENCH_WARMUP)
+#define BENCH_WARMUP 10
+#endif
+
+typedef struct {
+    const char *scope;
+    const char *key;
+    double *frames; // Milliseconds spent in the scope each measured frame
+} fwtBenchPhase;
+
+static fwtBenchPhase phases[] = {
+    {.scope = "update", .key = "update"},
+    {.scope = "fixedupdate", .key = "fixedUpdate"},
+    {.scope = "frame", .key = "recording"},
+    {.scope = "ProcessCommandQueue", .key = "replay"},
+    {.scope = "sgp_flush", .key = "flush"},
+    {.scope = "PaceFrame", .key = "pacing"},
+    {.scope = "FrameCallback", .key = "total"}
+};
+#define PHASE_COUNT (int)(sizeof(phases) / sizeof(phases[0]))
+
+static int CompareMilliseconds(const void *a, const void *b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+// Adds up every scope the main thread closed since `*head`, scenes can hit a phase more than once
+static void CollectPhases(uint64_t *head, int frame) {
+    fwtProfileBuffer *buffer = ThreadProfileBuffer();
+    assert(buffer);
+    assert(buffer->head - *head <= PROFILE_EVENTS_PER_THREAD);
+    for (int i = 0; i < PHASE_COUNT; i++)
+        phases[i].frames[frame] = 0.0;
+    for (; *head < buffer->head; (*head)++) {
+        fwtProfileEvent *event = &buffer->events[*head % PROFILE_EVENTS_PER_THREAD];
+        for (int i = 0; i < PHASE_COUNT; i++)
+            if (!strcmp(event->name, phases[i].scope)) {
+                phases[i].frames[frame] += stm_ms(stm_diff(event->end, event->start));
+                break;
+            }
+    }
+}
+
+static void WritePhase(Jim *jim, fwtBenchPhase *phase, int frames) {
+    qsort(phase->frames, frames, sizeof(double), CompareMilliseconds);
+    double total = 0.0;
+    for (int i = 0; i < frames; i++)
+        total += phase->frames[i];
+    jim_member_key(jim, phase->key);
+    jim_object_begin(jim);
+    jim_member_key(jim, "mean");
+    jim_float(jim, total / frames, 6);
+    jim_member_key(jim, "min");
+    jim_float(jim, phase->frames[0], 6);
+    jim_member_key(jim, "p99");
+    jim_float(jim, phase->frames[(int)ceil(frames * .99) - 1], 6);
+    jim_member_key(jim, "max");
+    jim_float(jim, phase->frames[frames - 1], 6);
+    jim_member_key(jim, "total");
+    jim_float(jim, total, 6);
+    jim_object_end(jim);
+}
+
+int main(int argc, char *argv[]) {
+    sargs_setup(&(sargs_desc) {
+        .argc = argc,
+        .argv = argv
+    });
+    const char *scene = sargs_value_def("scene", BENCH_DEFAULT_SCENE);
+    int frames = atoi(sargs_value_def("frames", "0"));
+    if (frames <= 0)
+        frames = BENCH_FRAMES;
+    double delta = atof(sargs_value_def("delta", "0"));
+    const char *out = sargs_value_def("out", "");
+    // Writes the last measured frame's commands for etc/replay-commands.c
+    const char *captureFile = sargs_value_def("capture", "");
+    state.argc = argc;
+    state.argv = argv;
+
+    // The scene is loaded by InitCallback like in the program, pacing would only measure sleep
+    fwtSwapToScene(&state, scene);
+    InitCallback();
+    // replayInput= pins the recording's delta during init, delta= still overrides it
+    if (delta > 0.0)
+        state.frameDelta = delta;
+    else if (state.frameDelta <= 0.0)
+        state.frameDelta = 1.0 / DEFAULT_TICK_RATE;
+    fwtSetTargetFPS(&state, 0.0);
+
+    for (int i = 0; i < PHASE_COUNT; i++) {
+        phases[i].frames = malloc(frames * sizeof(double));
+        assert(phases[i].frames);
+    }
+    for (int i = 0; i < BENCH_WARMUP; i++)
+        FrameCallback();
+    uint64_t head = ThreadProfileBuffer()->head;
+    double commands = 0.0, drawCalls = 0.0, vertices = 0.0, merged = 0.0;
+    uint64_t errorFrames = state.frameStats.errorFrames;
+    uint64_t start = stm_now();
+    for (int i = 0; i < frames; i++) {
+        if (*captureFile && i == frames - 1)
+            fwtCaptureFrame(&state, captureFile);
+        FrameCallback();
+        CollectPhases(&head, i);
+        commands += state.frameStats.commands;
+        drawCalls += state.frameStats.drawCalls;
+        vertices += state.frameStats.vertices;
+        merged += state.frameStats.mergedBatches;
+    }
+    double elapsed = stm_sec(stm_since(start));
+
+    FILE *fh = *out ? fopen(out, "w") : stdout;
+    if (!fh) {
+        fprintf(stderr, "[BENCH ERROR] Failed to open \"%s\"\n", out);
+        return 1;
+    }
+    Jim jim = {
+        .sink = fh,
+        .write = (Jim_Write)fwrite
+    };
+    jim_object_begin(&jim);
+    jim_member_key(&jim, "scene");
+    jim_string(&jim, scene);
+    jim_member_key(&jim, "frames");
+    jim_integer(&jim, frames);
+    jim_member_key(&jim, "delta");
+    jim_float(&jim, state.frameDelta, 6);
+    jim_member_key(&jim, "seconds");
+    jim_float(&jim, elapsed, 6);
+    jim_member_key(&jim, "fps");
+    jim_float(&jim, frames / elapsed, 2);
+    jim_member_key(&jim, "phases");
+    jim_object_begin(&jim);
+    for (int i = 0; i < PHASE_COUNT; i++)
+        WritePhase(&jim, &phases[i], frames);
+    jim_object_end(&jim);
+    jim_member_key(&jim, "render");
+    jim_object_begin(&jim);
+    jim_member_key(&jim, "commands");
+    jim_float(&jim, commands / frames, 2);
+    jim_member_key(&jim, "drawCalls");
+    jim_float(&jim, drawCalls / frames, 2);
+    jim_member_key(&jim, "vertices");
+    jim_float(&jim, vertices / frames, 2);
+    jim_member_key(&jim, "verticesPerSecond");
+    jim_float(&jim, vertices / elapsed, 0);
+    jim_member_key(&jim, "mergedBatches");
+    jim_float(&jim, merged / frames, 2);
+    jim_member_key(&jim, "errorFrames");
+    jim_integer(&jim, (long long)(state.frameStats.errorFrames - errorFrames));
+    jim_object_end(&jim);
+    jim_object_end(&jim);
+    if (fh != stdout)
+        fclose(fh);
+    else
+        printf("\n");
+
+    for (int i = 0; i < PHASE_COUNT; i++)
+        free(phases[i].frames);
+    CleanupCallback();
+    sargs_shutdown();
+    return 0;
+}
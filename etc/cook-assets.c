@@ -0,0 +1,174 @@
+/* cook-assets.c -- https://github.com/takeiteasy/fun-with-triangles
+
+ fun-with-triangles
+
+ Copyright (C) 2025  George Watson
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <https://www.gnu.org/licenses/>. */
+
+// Decodes every image in FWT_ASSETS_PATH and writes them to FWT_ASSETS_PACK_PATH as
+// GPU-ready pixels (see fwtPackHeader), fwtLoadTextureAsync then maps them instead of decoding.
+// Usage: cook-assets [-m] [assets directory] [pack path], -m also stores a full mip chain.
+// Build and run with `make assets`, FWT_TEXTURE_BGRA must match the program's.
+
+#include "fwt.c"
+
+typedef struct {
+    char name[MAX_PATH];
+    fwtPackEntry entry;
+    unsigned char *pixels;
+    size_t size;
+} fwtCookedImage;
+
+// Box filters `in` down one level, odd edges reuse their last texel
+static void Downsample(const unsigned char *in, int w, int h, unsigned char *out) {
+    int ow = w > 1 ? w / 2 : 1, oh = h > 1 ? h / 2 : 1;
+    for (int y = 0; y < oh; y++)
+        for (int x = 0; x < ow; x++) {
+            int x0 = x * 2, y0 = y * 2;
+            int x1 = x0 + 1 < w ? x0 + 1 : x0, y1 = y0 + 1 < h ? y0 + 1 : y0;
+            for (int c = 0; c < 4; c++)
+                out[(y * ow + x) * 4 + c] = (in[(y0 * w + x0) * 4 + c] + in[(y0 * w + x1) * 4 + c] +
+                                             in[(y1 * w + x0) * 4 + c] + in[(y1 * w + x1) * 4 + c] + 2) / 4;
+        }
+}
+
+static bool CookImage(const char *path, const char *name, bool mipmaps, fwtCookedImage *out) {
+    size_t size = 0;
+    int w, h, c;
+    unsigned char *data = (unsigned char*)LoadFile(path, &size);
+    if (!data)
+        return false;
+    if (size < 4 || (!CheckQOI(data) && !stbi_info_from_memory(data, (int)size, &w, &h, &c))) {
+        free(data);
+        return false;
+    }
+    unsigned char *pixels = (unsigned char*)LoadImage(data, (int)size, &w, &h);
+    free(data);
+    if (!pixels)
+        return false;
+
+    uint32_t levels = 1;
+    size_t total = (size_t)w * h * 4;
+    if (mipmaps)
+        for (int mw = w, mh = h; (mw > 1 || mh > 1) && levels < SG_MAX_MIPMAPS; levels++) {
+            mw = mw > 1 ? mw / 2 : 1;
+            mh = mh > 1 ? mh / 2 : 1;
+            total += (size_t)mw * mh * 4;
+        }
+    pixels = realloc(pixels, total);
+    assert(pixels);
+    unsigned char *level = pixels;
+    for (uint32_t i = 1, lw = w, lh = h; i < levels; i++) {
+        unsigned char *next = level + (size_t)lw * lh * 4;
+        Downsample(level, lw, lh, next);
+        level = next;
+        lw = lw > 1 ? lw / 2 : 1;
+        lh = lh > 1 ? lh / 2 : 1;
+    }
+
+    snprintf(out->name, MAX_PATH, "%s", name);
+    out->entry = (fwtPackEntry) {
+        .name = MurmurHash((void*)name, strlen(name), 0),
+        .w = w,
+        .h = h,
+        .mipmaps = levels
+    };
+    out->pixels = pixels;
+    out->size = total;
+    return true;
+}
+
+static int CompareCookedImages(const void *a, const void *b) {
+    uint64_t x = ((const fwtCookedImage*)a)->entry.name, y = ((const fwtCookedImage*)b)->entry.name;
+    return x < y ? -1 : x > y;
+}
+
+int main(int argc, char *argv[]) {
+    bool mipmaps = false;
+    const char *paths[2] = {FWT_ASSETS_PATH, FWT_ASSETS_PACK_PATH};
+    for (int i = 1, p = 0; i < argc; i++)
+        if (!strcmp(argv[i], "-m"))
+            mipmaps = true;
+        else if (p < 2)
+            paths[p++] = argv[i];
+
+    DIR *dir = opendir(paths[0]);
+    if (!dir) {
+        fprintf(stderr, "Failed to open \"%s\"\n", paths[0]);
+        return 1;
+    }
+    fwtCookedImage *images = NULL;
+    int count = 0, capacity = 0;
+    char full[MAX_PATH];
+    struct dirent *ent;
+    while ((ent = readdir(dir))) {
+        if (ent->d_name[0] == '.')
+            continue;
+        snprintf(full, MAX_PATH, "%s/%s", paths[0], ent->d_name);
+        if (!IsFile(full))
+            continue;
+        if (count == capacity) {
+            capacity = capacity ? capacity * 2 : 16;
+            images = realloc(images, capacity * sizeof(fwtCookedImage));
+            assert(images);
+        }
+        if (CookImage(full, ent->d_name, mipmaps, &images[count]))
+            count++;
+        else
+            fprintf(stderr, "Skipping \"%s\", not an image\n", full);
+    }
+    closedir(dir);
+
+    qsort(images, count, sizeof(fwtCookedImage), CompareCookedImages);
+    size_t offset = sizeof(fwtPackHeader) + count * sizeof(fwtPackEntry);
+    for (int i = 0; i < count; i++) {
+        if (i && images[i].entry.name == images[i - 1].entry.name) {
+            fprintf(stderr, "\"%s\" and \"%s\" have the same name hash\n", images[i - 1].name, images[i].name);
+            return 1;
+        }
+        offset = (offset + TEXTURE_PACK_ALIGN - 1) & ~(size_t)(TEXTURE_PACK_ALIGN - 1);
+        images[i].entry.offset = offset;
+        offset += images[i].size;
+    }
+
+    FILE *fh = fopen(paths[1], "wb");
+    if (!fh) {
+        fprintf(stderr, "Failed to open \"%s\"\n", paths[1]);
+        return 1;
+    }
+    fwtPackHeader header = {
+        .magic = TEXTURE_PACK_MAGIC,
+        .version = TEXTURE_PACK_VERSION,
+        .count = count,
+#if defined(FWT_TEXTURE_BGRA)
+        .bgra = 1
+#endif
+    };
+    fwrite(&header, sizeof(header), 1, fh);
+    for (int i = 0; i < count; i++)
+        fwrite(&images[i].entry, sizeof(fwtPackEntry), 1, fh);
+    static const unsigned char zeros[TEXTURE_PACK_ALIGN] = {0};
+    for (int i = 0; i < count; i++) {
+        fwrite(zeros, images[i].entry.offset - ftell(fh), 1, fh);
+        fwrite(images[i].pixels, images[i].size, 1, fh);
+        printf("%s: %ux%u, %u mipmap%s\n", images[i].name, images[i].entry.w, images[i].entry.h,
+               images[i].entry.mipmaps, images[i].entry.mipmaps == 1 ? "" : "s");
+        free(images[i].pixels);
+    }
+    fclose(fh);
+    free(images);
+    printf("Cooked %d image%s into \"%s\"\n", count, count == 1 ? "" : "s", paths[1]);
+    return 0;
+}
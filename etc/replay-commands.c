@@ -0,0 +1,154 @@
+/* replay-commands.c -- https://github.com/takeiteasy/fun-with-triangles
+
+ fun-with-triangles
+
+ Copyright (C) 2025  George Watson
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <https://www.gnu.org/licenses/>. */
+
+// Replays a frame written by fwtCaptureFrame (or `bench capture=...`) through ProcessCommand
+// on the dummy backend in a loop, so renderer changes can be profiled and A/B tested against
+// real frames without the scene or its game state. Textures are recreated empty at their
+// captured sizes, only the command stream is real.
+// Build with `make replay-commands`, run as `replay-commands <capture> [iterations]`.
+// Captures hold raw records, replay them with the same revision that captured them.
+
+#include "fwt.c"
+
+#if !defined(REPLAY_ITERATIONS)
+#define REPLAY_ITERATIONS 1000
+#endif
+
+static unsigned char* ReadCapture(const char *path, size_t *size) {
+    FILE *fh = fopen(path, "rb");
+    if (!fh)
+        return NULL;
+    fseek(fh, 0, SEEK_END);
+    *size = ftell(fh);
+    fseek(fh, 0, SEEK_SET);
+    // malloc's alignment keeps the stream as aligned as it was when it was captured
+    unsigned char *data = malloc(*size);
+    assert(data);
+    if (fread(data, 1, *size, fh) != *size) {
+        free(data);
+        data = NULL;
+    }
+    fclose(fh);
+    return data;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <capture> [iterations]\n", argv[0]);
+        return 1;
+    }
+    int iterations = argc > 2 ? atoi(argv[2]) : REPLAY_ITERATIONS, result = 0;
+    size_t size = 0;
+    unsigned char *data = ReadCapture(argv[1], &size);
+    if (!data) {
+        fprintf(stderr, "[REPLAY ERROR] Failed to read \"%s\"\n", argv[1]);
+        return 1;
+    }
+    fwtCaptureHeader header;
+    size_t offset = 0;
+    if (size >= sizeof(header)) {
+        memcpy(&header, data, sizeof(header));
+        // Bounded by the file first, so a corrupt count can't wrap the offset
+        if (header.textureCount <= (size - sizeof(header)) / sizeof(fwtCaptureTexture)) {
+            offset = sizeof(header) + header.textureCount * sizeof(fwtCaptureTexture);
+            offset += (16 - offset % 16) % 16;
+        }
+    }
+    if (!offset || offset > size ||
+        header.magic != COMMAND_CAPTURE_MAGIC || header.version != COMMAND_CAPTURE_VERSION ||
+        header.size > size - offset) {
+        fprintf(stderr, "[REPLAY ERROR] \"%s\" is not a capture from this version\n", argv[1]);
+        result = 1;
+        goto BAIL;
+    }
+
+    sg_setup(&(sg_desc) {0});
+    stm_setup();
+    sgp_setup(&(sgp_desc) {
+        .max_vertices = DEFAULT_MAX_VERTICES,
+        .max_commands = DEFAULT_MAX_COMMANDS
+    });
+    assert(sg_isvalid() && sgp_is_valid());
+    static unsigned int checkerboard[4] = {0xFFFF00FF, 0xFF000000, 0xFF000000, 0xFFFF00FF};
+    placeholderImage = ImmutableTexture((int*)checkerboard, 2, 2).internal;
+
+    // SetImage records index straight into state.textures, so the table is rebuilt slot for slot
+    state.textureCount = state.textureCapacity = header.textureCount;
+    state.textures = calloc(header.textureCount ? header.textureCount : 1, sizeof(fwtTexture));
+    assert(state.textures);
+    const unsigned char *entries = data + sizeof(header);
+    for (uint32_t i = 0; i < header.textureCount; i++) {
+        fwtCaptureTexture entry;
+        memcpy(&entry, entries + i * sizeof(entry), sizeof(entry));
+        fwtTexture *texture = &state.textures[i];
+        if (entry.w > 0 && entry.h > 0 && !entry.page)
+            *texture = EmptyTexture(entry.w, entry.h);
+        else
+            texture->internal.id = SG_INVALID_ID;
+        texture->w = entry.w;
+        texture->h = entry.h;
+        texture->page = entry.page;
+        texture->x = entry.x;
+        texture->y = entry.y;
+    }
+
+    const unsigned char *stream = data + offset;
+    int width = header.width ? (int)header.width : DEFAULT_WINDOW_WIDTH;
+    int height = header.height ? (int)header.height : DEFAULT_WINDOW_HEIGHT;
+    uint64_t replayTime = 0, flushTime = 0;
+    for (int i = 0; i < iterations; i++) {
+        sgp_begin(width, height);
+        ResetImageOffsets();
+        uint64_t start = stm_now();
+        ProcessCommandRange(stream, stream + header.size);
+        replayTime += stm_since(start);
+        CollectFrameStats();
+        sg_begin_default_pass(&state.pass_action, width, height);
+        start = stm_now();
+        sgp_flush();
+        flushTime += stm_since(start);
+        if ((state.frameStats.error = sgp_get_last_error()) != SGP_NO_ERROR)
+            state.frameStats.errorFrames++;
+        sgp_end();
+        sg_end_pass();
+        sg_commit();
+    }
+
+    fwtFrameStats *stats = &state.frameStats;
+    printf("capture:    %s (%llu bytes, %u commands, %u draws)\n", argv[1],
+           (unsigned long long)header.size, stats->commands, stats->draws);
+    printf("replay:     %.3f ms/frame\n", stm_ms(replayTime) / iterations);
+    printf("flush:      %.3f ms/frame\n", stm_ms(flushTime) / iterations);
+    printf("draw calls: %u (%u merged, %u texture binds)\n", stats->drawCalls, stats->mergedBatches, stats->textureBinds);
+    printf("vertices:   %u / %u\n", stats->vertices, stats->maxVertices);
+    if (stats->errorFrames)
+        printf("errors:     %s in %llu frames\n", sgp_get_error_message(stats->error),
+               (unsigned long long)stats->errorFrames);
+
+    for (uint32_t i = 0; i < header.textureCount; i++)
+        if (state.textures[i].internal.id != SG_INVALID_ID)
+            sg_destroy_image(state.textures[i].internal);
+    free(state.textures);
+    sg_destroy_image(placeholderImage);
+    sgp_shutdown();
+    sg_shutdown();
+BAIL:
+    free(data);
+    return result;
+}
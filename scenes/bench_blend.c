@@ -0,0 +1,66 @@
+#include "fwt.h"
+
+// count=10000 rects that switch blend mode on every draw, which stops sokol_gp merging any of
+// them. sorted=1 draws them through fwtBeginSortedDraws so they come back grouped by blend mode.
+// Run headless with `./build/bench scene=bench_blend count=10000 sorted=0`
+
+static const sgp_blend_mode modes[] = {
+    SGP_BLENDMODE_NONE,
+    SGP_BLENDMODE_BLEND,
+    SGP_BLENDMODE_ADD,
+    SGP_BLENDMODE_MOD,
+    SGP_BLENDMODE_MUL
+};
+#define MODE_COUNT (int)(sizeof(modes) / sizeof(modes[0]))
+
+struct fwtContext {
+    sgp_rect *rects;
+    int count;
+    bool sorted;
+};
+
+static fwtContext* init(fwtState *state) {
+    fwtContext *result = malloc(sizeof(struct fwtContext));
+    result->count = atoi(fwtArgument(state, "count", "10000"));
+    result->sorted = atoi(fwtArgument(state, "sorted", "0"));
+    result->rects = malloc(result->count * sizeof(sgp_rect));
+    int width, height;
+    fwtWindowSize(state, &width, &height);
+    srand(1);
+    for (int i = 0; i < result->count; i++)
+        result->rects[i] = (sgp_rect) {
+            .x = (float)(rand() % width),
+            .y = (float)(rand() % height),
+            .w = 16.f,
+            .h = 16.f
+        };
+    return result;
+}
+
+static void deinit(fwtState *state, fwtContext *context) {
+    free(context->rects);
+    free(context);
+}
+
+static void frame(fwtState *state, fwtContext *context, float alpha) {
+    if (context->sorted)
+        fwtBeginSortedDraws(state);
+    for (int i = 0; i < context->count; i++) {
+        if (context->sorted)
+            fwtSetLayer(state, 0);
+        fwtSetBlendMode(state, modes[i % MODE_COUNT]);
+        fwtSetColor(state, 1.f, .5f, .25f, .5f);
+        sgp_rect *rect = &context->rects[i];
+        fwtDrawFilledRect(state, rect->x, rect->y, rect->w, rect->h);
+    }
+    if (context->sorted)
+        fwtEndSortedDraws(state);
+    fwtResetBlendMode(state);
+    fwtResetColor(state);
+}
+
+EXPORT const fwtScene scene = {
+    .init = init,
+    .deinit = deinit,
+    .frame = frame
+};
@@ -0,0 +1,50 @@
+#include "fwt.h"
+
+// 100k lines by default, one fwtDrawLines call unless batch=0 (one fwtDrawLine each).
+// Run headless with `./build/bench scene=bench_lines count=100000 batch=1`
+
+struct fwtContext {
+    sgp_line *lines;
+    int count;
+    bool batch;
+};
+
+static fwtContext* init(fwtState *state) {
+    fwtContext *result = malloc(sizeof(struct fwtContext));
+    result->count = atoi(fwtArgument(state, "count", "100000"));
+    result->batch = atoi(fwtArgument(state, "batch", "1"));
+    result->lines = malloc(result->count * sizeof(sgp_line));
+    int width, height;
+    fwtWindowSize(state, &width, &height);
+    srand(1);
+    for (int i = 0; i < result->count; i++) {
+        float x = (float)(rand() % width), y = (float)(rand() % height);
+        result->lines[i] = (sgp_line) {
+            .a = {x, y},
+            .b = {x + (float)(rand() % 32) - 16.f, y + (float)(rand() % 32) - 16.f}
+        };
+    }
+    return result;
+}
+
+static void deinit(fwtState *state, fwtContext *context) {
+    free(context->lines);
+    free(context);
+}
+
+static void frame(fwtState *state, fwtContext *context, float alpha) {
+    fwtSetColor(state, 1.f, 1.f, 1.f, 1.f);
+    if (context->batch)
+        fwtDrawLines(state, context->lines, context->count);
+    else
+        for (int i = 0; i < context->count; i++) {
+            sgp_line *line = &context->lines[i];
+            fwtDrawLine(state, line->a.x, line->a.y, line->b.x, line->b.y);
+        }
+}
+
+EXPORT const fwtScene scene = {
+    .init = init,
+    .deinit = deinit,
+    .frame = frame
+};
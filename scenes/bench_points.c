@@ -0,0 +1,46 @@
+#include "fwt.h"
+
+// 100k points by default, one fwtDrawPoints call unless batch=0 (one fwtDrawPoint each).
+// Run headless with `./build/bench scene=bench_points count=100000 batch=1`
+
+struct fwtContext {
+    sgp_point *points;
+    int count;
+    bool batch;
+};
+
+static fwtContext* init(fwtState *state) {
+    fwtContext *result = malloc(sizeof(struct fwtContext));
+    result->count = atoi(fwtArgument(state, "count", "100000"));
+    result->batch = atoi(fwtArgument(state, "batch", "1"));
+    result->points = malloc(result->count * sizeof(sgp_point));
+    int width, height;
+    fwtWindowSize(state, &width, &height);
+    srand(1);
+    for (int i = 0; i < result->count; i++)
+        result->points[i] = (sgp_point) {
+            .x = (float)(rand() % width),
+            .y = (float)(rand() % height)
+        };
+    return result;
+}
+
+static void deinit(fwtState *state, fwtContext *context) {
+    free(context->points);
+    free(context);
+}
+
+static void frame(fwtState *state, fwtContext *context, float alpha) {
+    fwtSetColor(state, 1.f, 1.f, 1.f, 1.f);
+    if (context->batch)
+        fwtDrawPoints(state, context->points, context->count);
+    else
+        for (int i = 0; i < context->count; i++)
+            fwtDrawPoint(state, context->points[i].x, context->points[i].y);
+}
+
+EXPORT const fwtScene scene = {
+    .init = init,
+    .deinit = deinit,
+    .frame = frame
+};
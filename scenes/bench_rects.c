@@ -0,0 +1,89 @@
+#include "fwt.h"
+
+// 100k textured rects spread over textures=1/8/64. By default every rect binds its own texture
+// in turn (the worst case for batching), grouped=1 draws each texture's rects with a single
+// fwtDrawTexturedRects and atlas=1 packs the textures into one page with fwtPackTexture.
+// Run headless with `./build/bench scene=bench_rects count=100000 textures=8 grouped=0 atlas=0`
+
+#define TEXTURE_SIZE 16
+
+struct fwtContext {
+    sgp_textured_rect *rects;
+    int count;
+    uint64_t *textures;
+    ezImage *images; // fwtCreateTexture reads them when the command is replayed
+    int textureCount;
+    bool grouped;
+};
+
+static fwtContext* init(fwtState *state) {
+    fwtContext *result = malloc(sizeof(struct fwtContext));
+    result->count = atoi(fwtArgument(state, "count", "100000"));
+    result->textureCount = atoi(fwtArgument(state, "textures", "8"));
+    result->grouped = atoi(fwtArgument(state, "grouped", "0"));
+    bool atlas = atoi(fwtArgument(state, "atlas", "0"));
+    assert(result->textureCount > 0);
+
+    srand(1);
+    result->textures = malloc(result->textureCount * sizeof(uint64_t));
+    result->images = malloc(result->textureCount * sizeof(ezImage));
+    for (int i = 0; i < result->textureCount; i++) {
+        int *pixels = malloc(TEXTURE_SIZE * TEXTURE_SIZE * sizeof(int));
+        int color = 0xFF000000 | (rand() & 0xFFFFFF);
+        for (int j = 0; j < TEXTURE_SIZE * TEXTURE_SIZE; j++)
+            pixels[j] = color;
+        result->images[i] = (ezImage) {
+            .w = TEXTURE_SIZE,
+            .h = TEXTURE_SIZE,
+            .buf = pixels
+        };
+        char name[32];
+        snprintf(name, sizeof(name), "bench_rects_%d", i);
+        result->textures[i] = atlas ? fwtPackTexture(state, name, &result->images[i]) :
+                                      fwtCreateTexture(state, name, &result->images[i]);
+    }
+
+    int width, height;
+    fwtWindowSize(state, &width, &height);
+    result->rects = malloc(result->count * sizeof(sgp_textured_rect));
+    for (int i = 0; i < result->count; i++)
+        result->rects[i] = (sgp_textured_rect) {
+            .dst = {(float)(rand() % width), (float)(rand() % height), 8.f, 8.f},
+            .src = {0.f, 0.f, TEXTURE_SIZE, TEXTURE_SIZE}
+        };
+    return result;
+}
+
+static void deinit(fwtState *state, fwtContext *context) {
+    for (int i = 0; i < context->textureCount; i++) {
+        fwtDestroyTexture(state, context->textures[i]);
+        free(context->images[i].buf);
+    }
+    free(context->textures);
+    free(context->images);
+    free(context->rects);
+    free(context);
+}
+
+static void frame(fwtState *state, fwtContext *context, float alpha) {
+    if (context->grouped) {
+        // Texture i owns the i-th slice of the rects
+        for (int i = 0; i < context->textureCount; i++) {
+            int first = (int)((int64_t)context->count * i / context->textureCount);
+            int last = (int)((int64_t)context->count * (i + 1) / context->textureCount);
+            fwtSetImage(state, context->textures[i], 0);
+            fwtDrawTexturedRects(state, 0, context->rects + first, last - first);
+        }
+    } else
+        for (int i = 0; i < context->count; i++) {
+            fwtSetImage(state, context->textures[i % context->textureCount], 0);
+            fwtDrawTexturedRect(state, 0, context->rects[i].dst, context->rects[i].src);
+        }
+    fwtResetImage(state, 0);
+}
+
+EXPORT const fwtScene scene = {
+    .init = init,
+    .deinit = deinit,
+    .frame = frame
+};
@@ -0,0 +1,64 @@
+#include "fwt.h"
+
+// A tree of depth=6 levels with fanout=4 children per node (5461 nodes by default), every node
+// pushes a transform, translates, rotates and scales before drawing a rect and recursing.
+// Run headless with `./build/bench scene=bench_transforms depth=6 fanout=4`
+
+struct fwtContext {
+    int depth, fanout;
+    float time;
+};
+
+static fwtContext* init(fwtState *state) {
+    fwtContext *result = malloc(sizeof(struct fwtContext));
+    result->depth = atoi(fwtArgument(state, "depth", "6"));
+    result->fanout = atoi(fwtArgument(state, "fanout", "4"));
+    result->time = 0.f;
+    // sokol_gp's transform stack is 64 deep and each level pushes twice
+    assert(result->depth > 0 && result->depth * 2 < 63);
+    return result;
+}
+
+static void deinit(fwtState *state, fwtContext *context) {
+    free(context);
+}
+
+static bool update(fwtState *state, fwtContext *context, float delta) {
+    context->time += delta;
+    return true;
+}
+
+static void DrawNode(fwtState *state, fwtContext *context, int depth) {
+    fwtPushTransform(state);
+    fwtRotate(state, context->time * (float)(depth + 1) * .1f);
+    fwtScale(state, .5f, .5f);
+    fwtSetColor(state, (float)depth / context->depth, .5f, 1.f - (float)depth / context->depth, 1.f);
+    fwtDrawFilledRect(state, -16.f, -16.f, 32.f, 32.f);
+    if (depth + 1 < context->depth)
+        for (int i = 0; i < context->fanout; i++) {
+            float angle = 6.2831853f * i / context->fanout;
+            fwtPushTransform(state);
+            fwtTranslate(state, cosf(angle) * 96.f, sinf(angle) * 96.f);
+            DrawNode(state, context, depth + 1);
+            fwtPopTransform(state);
+        }
+    fwtPopTransform(state);
+}
+
+static void frame(fwtState *state, fwtContext *context, float alpha) {
+    int width, height;
+    fwtWindowSize(state, &width, &height);
+    fwtPushTransform(state);
+    fwtTranslate(state, width * .5f, height * .5f);
+    fwtScale(state, 2.f, 2.f);
+    DrawNode(state, context, 0);
+    fwtPopTransform(state);
+    fwtResetColor(state);
+}
+
+EXPORT const fwtScene scene = {
+    .init = init,
+    .deinit = deinit,
+    .update = update,
+    .frame = frame
+};
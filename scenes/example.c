@@ -37,14 +37,17 @@ static void unload(fwtState *state, fwtContext *context) {
 }
 
 /* INFO:
-   `event` is called when a window event is generated */
-static void event(fwtState *state, fwtContext *context, fwtEventType event) {
-    printf("Wow! Some sort of event!\n");
+   `event` is called once at the start of a frame with every input and window event since the last frame,
+   oldest first. Each one is the full `sapp_event`, the array is only valid during the call */
+static void event(fwtState *state, fwtContext *context, const sapp_event *events, int count) {
+    for (int i = 0; i < count; i++)
+        if (events[i].type == SAPP_EVENTTYPE_KEY_DOWN && !events[i].key_repeat)
+            printf("Wow! Key %d was pressed!\n", events[i].key_code);
 }
 
 /* INFO:
    `frame` is, as the name suggests, called every frame. All your rendering code should probably go here. */
-static void frame(fwtState *state, fwtContext *context, float delta) {
+static void frame(fwtState *state, fwtContext *context, float alpha) {
     // Put your rendering code in here ...
 }
 
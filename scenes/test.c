@@ -18,6 +18,21 @@ static void deinit(fwtState* state, fwtContext *context) {
     free(context);
 }
 
+static void* serialize(fwtState* state, fwtContext *context, size_t *size) {
+    fwtContext *result = malloc(sizeof(struct fwtContext));
+    memcpy(result, context, sizeof(struct fwtContext));
+    *size = sizeof(struct fwtContext);
+    return result;
+}
+
+static fwtContext* deserialize(fwtState* state, const void *data, size_t size) {
+    if (size != sizeof(struct fwtContext))
+        return NULL;
+    fwtContext *result = malloc(sizeof(struct fwtContext));
+    memcpy(result, data, size);
+    return result;
+}
+
 static void reload(fwtState* state, fwtContext *context) {
 
 }
@@ -26,11 +41,11 @@ static void unload(fwtState* state, fwtContext *context) {
 
 }
 
-static void event(fwtState* state, fwtContext *context, fwtEventType event) {
+static void event(fwtState* state, fwtContext *context, const sapp_event *events, int count) {
 
 }
 
-static void frame(fwtState* state, fwtContext *context, float delta) {
+static void frame(fwtState* state, fwtContext *context, float alpha) {
     int width, height;
     fwtWindowSize(state, &width, &height);
     float ratio = (float)width / (float)height;
@@ -49,5 +64,7 @@ EXPORT const fwtScene scene = {
     .reload = reload,
     .unload = unload,
     .event = event,
-    .frame = frame
+    .frame = frame,
+    .serialize = serialize,
+    .deserialize = deserialize
 };
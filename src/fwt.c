@@ -24,8 +24,20 @@
  SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE. */
 
 #define BLA_IMPLEMENTATION
+#if defined(FWT_HEADLESS)
+// No window or swapchain, only the renderer (see etc/bench-commands.c)
+#define SOKOL_GFX_IMPL
+#define SOKOL_GP_IMPL
+#define SOKOL_TIME_IMPL
+#define SOKOL_ARGS_IMPL
+#else
 #define SOKOL_IMPL
+#endif
 #include "fwt.h"
+#if defined(FWT_SCENE)
+// Scenes parse the arguments with their own copy of sokol_args, see fwtArgument
+#define SOKOL_ARGS_IMPL
+#endif
 #include "sokol_args.h"
 #include "sokol_time.h"
 #define JIM_IMPLEMENTATION
@@ -43,6 +55,11 @@
 #include "table.h"
 #define GARRY_IMPLEMENTATION
 #include "garry.h"
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
 #if defined(FWT_WINDOW)
 #include "dirent_win32.h"
 #include "dlfcn_win32.h"
@@ -67,105 +84,139 @@ static bool IsFile(const char *path) {
     return S_ISREG(st.st_mode);
 }
 
-static int CountFilesInDir(const char *path) {
-    int result = 0;
-    char full[MAX_PATH];
-    DIR *dir = opendir(path);
-    assert(dir);
-    struct dirent *ent;
-    while ((ent = readdir(dir))) {
-        sprintf(full, "%s%s", path, ent->d_name);
-        if (IsFile(full))
-            result++;
-        full[0] = '\0';
-    }
-    closedir(dir);
-    return result;
+#if !defined(FWT_RELEASE)
+#if defined(FWT_SCENE)
+fwtProfiler *fwtActiveProfiler = NULL;
+#else
+static fwtProfileBuffer* ThreadProfileBuffer(void);
+static fwtProfiler profiler = {.threadBuffer = ThreadProfileBuffer};
+fwtProfiler *fwtActiveProfiler = &profiler;
+
+static _Thread_local fwtProfileBuffer *profileBuffer = NULL;
+static _Thread_local bool profileFull = false;
+
+// Each thread registers its own buffer on its first scope, after that recording is lock-free.
+// Scenes reach this through the profiler, their own copies of these thread locals are never used
+static fwtProfileBuffer* ThreadProfileBuffer(void) {
+    if (profileBuffer || profileFull)
+        return profileBuffer;
+    int index = __atomic_fetch_add(&profiler.bufferCount, 1, __ATOMIC_RELAXED);
+    if (index >= MAX_PROFILE_THREADS) {
+        fprintf(stderr, "[PROFILE ERROR] More than MAX_PROFILE_THREADS (%d) threads\n", MAX_PROFILE_THREADS);
+        profileFull = true;
+        return NULL;
+    }
+    profileBuffer = calloc(1, sizeof(fwtProfileBuffer));
+    assert(profileBuffer);
+    __atomic_store_n(&profiler.buffers[index], profileBuffer, __ATOMIC_RELEASE);
+    return profileBuffer;
 }
+#endif
 
-static const char** GetFilesInDir(const char *path, int *count_out) {
-    int count = CountFilesInDir(path);
-    const char** result = malloc(sizeof(char*) * count);
-    int index = 0;
-    char full[MAX_PATH];
-    DIR *dir = opendir(path);
-    assert(dir);
-    struct dirent *ent;
-    while ((ent = readdir(dir))) {
-        sprintf(full, "%s%s", path, ent->d_name);
-        if (IsFile(full))
-            result[index++] = ent->d_name;
-        full[0] = '\0';
-    }
-    closedir(dir);
-    if (count_out)
-        *count_out = count;
-    for (int i = 0; i < count; i++)
-        printf("%s\n", result[i]);
-    return result;
+fwtProfileZone fwtProfileBegin(const char *name) {
+    return (fwtProfileZone) {
+        .name = name,
+        .start = stm_now()
+    };
 }
 
-static void AssetWatchCallback(dmon_watch_id watch_id,
-                               dmon_action action,
-                               const char* rootdir,
-                               const char* filepath,
-                               const char* oldfilepath,
-                               void* user) {
-//    if (DoesFileExist(FWT_ASSETS_PATH_OUT))
-//        remove(FWT_ASSETS_PATH_OUT);
-
-    // TODO: Check if file exists inside map
-    // TODO: Compare file hashes
-
-    switch (action) {
-        case DMON_ACTION_CREATE:
-            break;
-        case DMON_ACTION_DELETE:
-            break;
-        case DMON_ACTION_MODIFY:
-            break;
-        case DMON_ACTION_MOVE:
-            break;
+void fwtProfileEnd(fwtProfileZone *zone) {
+    uint64_t end = stm_now();
+    fwtProfileBuffer *buffer = fwtActiveProfiler ? fwtActiveProfiler->threadBuffer() : NULL;
+    if (!buffer)
+        return;
+    uint64_t head = buffer->head;
+    fwtProfileEvent *event = &buffer->events[head % PROFILE_EVENTS_PER_THREAD];
+    snprintf(event->name, PROFILE_NAME_LENGTH, "%s", zone->name);
+    event->start = zone->start;
+    event->end = end;
+    __atomic_store_n(&buffer->head, head + 1, __ATOMIC_RELEASE);
+}
+
+// Other threads keep recording while this runs, so their oldest events may be torn
+bool fwtDumpProfile(const char *path) {
+    if (!fwtActiveProfiler)
+        return false;
+    FILE *fh = fopen(path, "w");
+    if (!fh)
+        return false;
+    Jim jim = {
+        .sink = fh,
+        .write = (Jim_Write)fwrite
+    };
+    jim_object_begin(&jim);
+    jim_member_key(&jim, "displayTimeUnit");
+    jim_string(&jim, "ms");
+    jim_member_key(&jim, "traceEvents");
+    jim_array_begin(&jim);
+    int count = __atomic_load_n(&fwtActiveProfiler->bufferCount, __ATOMIC_RELAXED);
+    for (int i = 0; i < count && i < MAX_PROFILE_THREADS; i++) {
+        fwtProfileBuffer *buffer = __atomic_load_n(&fwtActiveProfiler->buffers[i], __ATOMIC_ACQUIRE);
+        if (!buffer)
+            continue;
+        uint64_t head = __atomic_load_n(&buffer->head, __ATOMIC_ACQUIRE);
+        uint64_t first = head > PROFILE_EVENTS_PER_THREAD ? head - PROFILE_EVENTS_PER_THREAD : 0;
+        for (uint64_t j = first; j < head; j++) {
+            fwtProfileEvent *event = &buffer->events[j % PROFILE_EVENTS_PER_THREAD];
+            jim_object_begin(&jim);
+            jim_member_key(&jim, "name");
+            jim_string(&jim, event->name);
+            jim_member_key(&jim, "ph");
+            jim_string(&jim, "X");
+            jim_member_key(&jim, "ts");
+            jim_float(&jim, stm_us(event->start), 3);
+            jim_member_key(&jim, "dur");
+            jim_float(&jim, stm_us(stm_diff(event->end, event->start)), 3);
+            jim_member_key(&jim, "pid");
+            jim_integer(&jim, 0);
+            jim_member_key(&jim, "tid");
+            jim_integer(&jim, i);
+            jim_object_end(&jim);
+        }
     }
-    return;
+    jim_array_end(&jim);
+    jim_object_end(&jim);
+    fclose(fh);
+    return true;
+}
+#endif
 
-    int count = 0;
-#if defined(FWT_POSIX)
-    const char **files = GetFilesInDir(rootdir, &count);
+#if !defined(FWT_SCENE)
+// Decoders output RGBA8, define FWT_TEXTURE_BGRA to swizzle on load for backends that prefer BGRA8
+#if defined(FWT_TEXTURE_BGRA)
+#define TEXTURE_PIXEL_FORMAT SG_PIXELFORMAT_BGRA8
 #else
-    char appended[MAX_PATH];
-    memcpy(appended, rootdir, strlen(rootdir) * sizeof(char));
-    const char **files = GetFilesInDir(appended, &count);
+#define TEXTURE_PIXEL_FORMAT SG_PIXELFORMAT_RGBA8
 #endif
-    assert(count);
-    free(files);
-}
 
-#if !defined(FWT_SCENE)
-static fwtTexture* NewTexture(sg_image_desc *desc) {
-    fwtTexture *result = malloc(sizeof(fwtTexture));
-    result->internal = sg_make_image(desc);
-    result->w = desc->width;
-    result->h = desc->height;
-    return result;
+// Bumped whenever an sg_image is made or destroyed. Retained list caches hold the image
+// ids their draws were issued with, so a cache from an older epoch is never replayed
+static uint64_t textureEpoch = 0;
+
+static fwtTexture NewTexture(sg_image_desc *desc) {
+    textureEpoch++;
+    return (fwtTexture) {
+        .internal = sg_make_image(desc),
+        .w = desc->width,
+        .h = desc->height
+    };
 }
 
-static fwtTexture* EmptyTexture(unsigned int w, unsigned int h) {
+static fwtTexture EmptyTexture(unsigned int w, unsigned int h) {
     sg_image_desc desc = {
         .width = w,
         .height = h,
-        .pixel_format = SG_PIXELFORMAT_RGBA8,
+        .pixel_format = TEXTURE_PIXEL_FORMAT,
         .usage = SG_USAGE_STREAM
     };
     return NewTexture(&desc);
 }
 
 static void DestroyTexture(fwtTexture *texture) {
-    if (texture) {
-        if (sg_query_image_state(texture->internal) == SG_RESOURCESTATE_VALID)
-            sg_destroy_image(texture->internal);
-        free(texture);
-    }
+    textureEpoch++;
+    if (sg_query_image_state(texture->internal) == SG_RESOURCESTATE_VALID)
+        sg_destroy_image(texture->internal);
+    texture->internal.id = SG_INVALID_ID;
 }
 
 #define QOI_MAGIC (((unsigned int)'q') << 24 | ((unsigned int)'o') << 16 | ((unsigned int)'i') <<  8 | ((unsigned int)'f'))
@@ -174,39 +225,111 @@ static bool CheckQOI(unsigned char *data) {
     return (data[0] << 24 | data[1] << 16 | data[2] << 8 | data[3]) == QOI_MAGIC;
 }
 
-#define RGBA(R, G, B, A) (((unsigned int)(A) << 24) | ((unsigned int)(R) << 16) | ((unsigned int)(G) << 8) | (B))
+// Swaps the R and B channels of `count` packed RGBA8 pixels in place, row-major
+static void SwizzleRGBA(unsigned char *pixels, size_t count) {
+    size_t i = 0;
+#if defined(__AVX2__)
+    const __m256i ga = _mm256_set1_epi32(0xFF00FF00), rb = _mm256_set1_epi32(0x000000FF);
+    for (; i + 8 <= count; i += 8) {
+        __m256i p = _mm256_loadu_si256((__m256i*)(pixels + i * 4));
+        __m256i r = _mm256_and_si256(p, rb);
+        __m256i b = _mm256_and_si256(_mm256_srli_epi32(p, 16), rb);
+        p = _mm256_or_si256(_mm256_and_si256(p, ga), _mm256_or_si256(_mm256_slli_epi32(r, 16), b));
+        _mm256_storeu_si256((__m256i*)(pixels + i * 4), p);
+    }
+#elif defined(__SSE2__)
+    const __m128i ga = _mm_set1_epi32(0xFF00FF00), rb = _mm_set1_epi32(0x000000FF);
+    for (; i + 4 <= count; i += 4) {
+        __m128i p = _mm_loadu_si128((__m128i*)(pixels + i * 4));
+        __m128i r = _mm_and_si128(p, rb);
+        __m128i b = _mm_and_si128(_mm_srli_epi32(p, 16), rb);
+        p = _mm_or_si128(_mm_and_si128(p, ga), _mm_or_si128(_mm_slli_epi32(r, 16), b));
+        _mm_storeu_si128((__m128i*)(pixels + i * 4), p);
+    }
+#elif defined(__ARM_NEON)
+    for (; i + 16 <= count; i += 16) {
+        uint8x16x4_t p = vld4q_u8(pixels + i * 4);
+        uint8x16_t r = p.val[0];
+        p.val[0] = p.val[2];
+        p.val[2] = r;
+        vst4q_u8(pixels + i * 4, p);
+    }
+#endif
+    for (; i < count; i++) {
+        unsigned char *p = pixels + i * 4;
+        unsigned char r = p[0];
+        p[0] = p[2];
+        p[2] = r;
+    }
+}
 
+// Returns the decoder's buffer as is (RGBA8, or BGRA8 with FWT_TEXTURE_BGRA), free with free().
+// NULL if it doesn't decode, hot reload can pick up a file an editor is still writing
 static int* LoadImage(unsigned char *data, int sizeOfData, int *w, int *h) {
-    assert(data && sizeOfData);
-    int _w, _h, c;
+    if (!data || sizeOfData < 4)
+        return NULL;
+    int _w = 0, _h = 0, c;
     unsigned char *in = NULL;
     if (CheckQOI(data)) {
         qoi_desc desc;
-        in = qoi_decode(data, sizeOfData, &desc, 4);
-        _w = desc.width;
-        _h = desc.height;
+        if ((in = qoi_decode(data, sizeOfData, &desc, 4))) {
+            _w = desc.width;
+            _h = desc.height;
+        }
     } else
         in = stbi_load_from_memory(data, sizeOfData, &_w, &_h, &c, 4);
-    assert(in && _w && _h);
-
-    int *buf = malloc(_w * _h * sizeof(int));
-    for (int x = 0; x < _w; x++)
-        for (int y = 0; y < _h; y++) {
-            unsigned char *p = in + (x + _w * y) * 4;
-            buf[y * _w + x] = RGBA(p[0], p[1], p[2], p[3]);
-        }
-    free(in);
+    if (!in || !_w || !_h) {
+        free(in);
+        return NULL;
+    }
+#if defined(FWT_TEXTURE_BGRA)
+    SwizzleRGBA(in, (size_t)_w * _h);
+#endif
     if (w)
         *w = _w;
     if (h)
         *h = _h;
-    return buf;
+    return (int*)in;
+}
+
+static fwtTexture ImmutableTexture(int *data, int w, int h) {
+    sg_image_desc desc = {
+        .width = w,
+        .height = h,
+        .pixel_format = TEXTURE_PIXEL_FORMAT,
+        .data.subimage[0][0] = (sg_range) {
+            .ptr = data,
+            .size = w * h * sizeof(int)
+        }
+    };
+    return NewTexture(&desc);
+}
+
+// Mip levels point straight into the mapped pack, nothing is decoded or copied on the CPU
+static fwtTexture PackedTexture(const fwtTexturePack *pack, const fwtPackEntry *entry) {
+    sg_image_desc desc = {
+        .width = entry->w,
+        .height = entry->h,
+        .num_mipmaps = entry->mipmaps,
+        .pixel_format = TEXTURE_PIXEL_FORMAT
+    };
+    const unsigned char *pixels = (const unsigned char*)pack->data + entry->offset;
+    for (uint32_t i = 0; i < entry->mipmaps; i++) {
+        size_t w = entry->w >> i ? entry->w >> i : 1;
+        size_t h = entry->h >> i ? entry->h >> i : 1;
+        desc.data.subimage[0][i] = (sg_range) {
+            .ptr = pixels,
+            .size = w * h * sizeof(int)
+        };
+        pixels += w * h * sizeof(int);
+    }
+    return NewTexture(&desc);
 }
 
 static void UpdateTexture(fwtTexture *texture, int *data, int w, int h) {
     if (texture->w != w || texture->h != h) {
         DestroyTexture(texture);
-        texture = EmptyTexture(w, h);
+        *texture = EmptyTexture(w, h);
     }
     sg_image_data desc = {
         .subimage[0][0] = (sg_range) {
@@ -225,6 +348,7 @@ fwtState state = {
 #undef X
         .window_title = DEFAULT_WINDOW_TITLE
     },
+    .tickRate = DEFAULT_TICK_RATE,
     .pass_action = {
         .colors[0] = {
             .load_action = SG_LOADACTION_CLEAR,
@@ -274,16 +398,209 @@ typedef enum {
     fwtCommandDrawFilledRect,
     fwtCommandDrawTexturedRects,
     fwtCommandDrawTexturedRect,
-    fwtCommandCreateTexture
+    fwtCommandCreateTexture,
+    fwtCommandDestroyTexture,
+    fwtCommandBeginSort,
+    fwtCommandSortItem,
+    fwtCommandSubmitList,
+    fwtCommandCreatePackedTexture,
+    fwtCommandPad,
+    fwtCommandCount
 } fwtCommandType;
 
+// Commands are serialized into a per-frame linear arena (`state->commandBuffer`) as
+// packed variable-length records: a 1-byte opcode immediately followed by its payload.
+// Payloads are unaligned, so they are always copied in and out with memcpy. The arena
+// only grows while warming up and is rewound once the frame has been committed.
+static unsigned char* ReserveCommand(fwtCommandBuffer *buffer, size_t recordSize) {
+    if (buffer->size + recordSize > buffer->capacity) {
+        size_t newCapacity = buffer->capacity ? buffer->capacity : DEFAULT_COMMAND_BUFFER_SIZE;
+        while (newCapacity < buffer->size + recordSize)
+            newCapacity *= 2;
+        buffer->data = realloc(buffer->data, newCapacity);
+        assert(buffer->data);
+        buffer->capacity = newCapacity;
+    }
+    unsigned char *record = buffer->data + buffer->size;
+    buffer->size += recordSize;
+    return record;
+}
+
+// Set while a worker thread is recording (see fwtBeginThreadCommands)
+static _Thread_local fwtCommandBuffer *threadCommandBuffer = NULL;
+// Set between fwtBeginCommandList/fwtEndCommandList, takes priority over the above
+static _Thread_local fwtCommandBuffer *listCommandBuffer = NULL;
+
+static fwtCommandBuffer* CurrentCommandBuffer(fwtState *state) {
+    if (listCommandBuffer)
+        return listCommandBuffer;
+    return threadCommandBuffer ? threadCommandBuffer : &state->commandBuffer;
+}
+
+static void PushCommand(fwtState* state, fwtCommandType type, const void *payload, size_t size) {
+    unsigned char *record = ReserveCommand(CurrentCommandBuffer(state), 1 + size);
+    record[0] = (unsigned char)type;
+    if (size)
+        memcpy(record + 1, payload, size);
+}
+
+// Arrays (vertices, rects, uniform data) are copied inline after the payload, padded so
+// they can be handed straight to sokol_gp. The caller's buffer can be reused immediately.
+#define COMMAND_ARRAY_ALIGN 4
+#define COMMAND_ARRAY_ALIGN_UP(N) (((N) + (COMMAND_ARRAY_ALIGN - 1)) & ~(uintptr_t)(COMMAND_ARRAY_ALIGN - 1))
+
+static void PushCommandArray(fwtState* state, fwtCommandType type, const void *payload, size_t size, const void *array, size_t arraySize) {
+    fwtCommandBuffer *buffer = CurrentCommandBuffer(state);
+    size_t arrayOffset = COMMAND_ARRAY_ALIGN_UP(buffer->size + 1 + size) - buffer->size;
+    unsigned char *record = ReserveCommand(buffer, arrayOffset + arraySize);
+    record[0] = (unsigned char)type;
+    memcpy(record + 1, payload, size);
+    if (arraySize)
+        memcpy(record + arrayOffset, array, arraySize);
+}
+
+// Worker threads claim their own buffer for the rest of the frame, so recording never
+// contends on the main queue. Buffers are replayed after the main thread's commands in
+// ascending `key` order, keys should be unique so the merge is deterministic. Workers
+// must have finished recording before the scene's callback returns.
+// Workers read the texture table (fwtSetImage, fwtIsTextureValid) without a lock, so
+// textures are created and destroyed on the main thread before or after they record.
+void fwtBeginThreadCommands(fwtState *state, uint32_t key) {
+    assert(!threadCommandBuffer);
+    __atomic_add_fetch(&state->threadRecorders, 1, __ATOMIC_ACQ_REL);
+    int slot = __atomic_fetch_add(&state->threadCommandBufferCount, 1, __ATOMIC_RELAXED);
+    assert(slot < MAX_THREAD_COMMAND_BUFFERS);
+    threadCommandBuffer = &state->threadCommandBuffers[slot];
+    threadCommandBuffer->key = key;
+}
+
+void fwtEndThreadCommands(fwtState *state) {
+    assert(threadCommandBuffer);
+    threadCommandBuffer = NULL;
+    __atomic_sub_fetch(&state->threadRecorders, 1, __ATOMIC_ACQ_REL);
+}
+
+// Retained lists are recorded once and submitted every frame. The first replay also
+// keeps a copy of the vertices, uniforms and commands sokol_gp produced for the list,
+// later submits with identical sokol_gp state (transform, projection, colour, ...)
+// copy those straight into sokol_gp's buffers instead of replaying the records.
+struct fwtCommandList {
+    fwtCommandBuffer buffer;
+    void *cache;
+    size_t cacheCapacity;
+};
+
+fwtCommandList* fwtBeginCommandList(fwtState *state) {
+    assert(!listCommandBuffer);
+    fwtCommandList *list = calloc(1, sizeof(fwtCommandList));
+    assert(list);
+    listCommandBuffer = &list->buffer;
+    return list;
+}
+
+void fwtEndCommandList(fwtState *state) {
+    assert(listCommandBuffer && !listCommandBuffer->sortSection);
+    listCommandBuffer = NULL;
+}
+
+typedef struct {
+    fwtCommandList *list;
+} fwtSubmitListData;
+
+void fwtSubmitCommandList(fwtState *state, fwtCommandList *list) {
+    assert(list && &list->buffer != listCommandBuffer);
+    fwtSubmitListData data = {
+        .list = list
+    };
+    PushCommand(state, fwtCommandSubmitList, &data, sizeof(data));
+}
+
+// Lists must outlive the frame they were last submitted in
+void fwtDestroyCommandList(fwtCommandList *list) {
+    if (list) {
+        free(list->buffer.data);
+        free(list->cache);
+        free(list);
+    }
+}
+
+// Draws between fwtBeginSortedDraws/fwtEndSortedDraws are split into items, a new item
+// starts with every fwtSetLayer. Before replay the items are stable-sorted by
+// (layer, pipeline, texture, blend) so sokol_gp can merge them into fewer batches,
+// items with equal keys keep their submission order. Items are replayed in isolation
+// so each one should set up (and undo) any transform/colour state it depends on.
+typedef struct {
+    uint32_t size;
+} fwtBeginSortData;
+
 typedef struct {
-    fwtCommandType type;
-    void* data;
-} fwtCommand;
+    uint64_t key;
+    uint32_t size;
+} fwtSortItemData;
+
+#define SORT_KEY_LAYER(L) ((uint64_t)(L) << 48)
+#define SORT_KEY_PIPELINE(P) ((uint64_t)((P) & 0xFF) << 40)
+#define SORT_KEY_TEXTURE(T) ((uint64_t)(uint32_t)(T) << 8)
+#define SORT_KEY_BLEND(B) ((uint64_t)((B) & 0xFF))
+#define SORT_KEY_PIPELINE_MASK SORT_KEY_PIPELINE(0xFF)
+#define SORT_KEY_TEXTURE_MASK SORT_KEY_TEXTURE(0xFFFFFFFF)
+#define SORT_KEY_BLEND_MASK SORT_KEY_BLEND(0xFF)
+
+static void PatchSortRecord(fwtCommandBuffer *buffer, size_t marker, uint64_t mask, uint64_t bits, bool close) {
+    fwtSortItemData data;
+    unsigned char *payload = buffer->data + marker;
+    memcpy(&data, payload, sizeof(data));
+    data.key = (data.key & ~mask) | bits;
+    if (close)
+        data.size = (uint32_t)(buffer->size - (marker + sizeof(data)));
+    memcpy(payload, &data, sizeof(data));
+}
+
+static void UpdateSortKey(fwtState *state, uint64_t mask, uint64_t bits) {
+    fwtCommandBuffer *buffer = CurrentCommandBuffer(state);
+    if (buffer->sortItem)
+        PatchSortRecord(buffer, buffer->sortItem, mask, bits, false);
+}
+
+static void CloseSortItem(fwtCommandBuffer *buffer) {
+    if (buffer->sortItem)
+        PatchSortRecord(buffer, buffer->sortItem, 0, 0, true);
+    buffer->sortItem = 0;
+}
+
+void fwtSetLayer(fwtState *state, uint16_t layer) {
+    fwtCommandBuffer *buffer = CurrentCommandBuffer(state);
+    assert(buffer->sortSection);
+    CloseSortItem(buffer);
+    fwtSortItemData data = {
+        .key = SORT_KEY_LAYER(layer) | SORT_KEY_BLEND(SGP_BLENDMODE_NONE),
+        .size = 0
+    };
+    PushCommand(state, fwtCommandSortItem, &data, sizeof(data));
+    // Markers store the offset of their payload, it is never 0 as the opcode comes first
+    buffer->sortItem = buffer->size - sizeof(data);
+}
+
+void fwtBeginSortedDraws(fwtState *state) {
+    fwtCommandBuffer *buffer = CurrentCommandBuffer(state);
+    assert(!buffer->sortSection);
+    fwtBeginSortData data = {
+        .size = 0
+    };
+    PushCommand(state, fwtCommandBeginSort, &data, sizeof(data));
+    buffer->sortSection = buffer->size - sizeof(data);
+    fwtSetLayer(state, 0);
+}
 
-static void PushCommand(fwtState* state, fwtCommand* command) {
-    ezStackAppend(&state->commandQueue, command->type, (void*)command);
+void fwtEndSortedDraws(fwtState *state) {
+    fwtCommandBuffer *buffer = CurrentCommandBuffer(state);
+    assert(buffer->sortSection);
+    CloseSortItem(buffer);
+    fwtBeginSortData data = {
+        .size = (uint32_t)(buffer->size - (buffer->sortSection + sizeof(data)))
+    };
+    memcpy(buffer->data + buffer->sortSection, &data, sizeof(data));
+    buffer->sortSection = 0;
 }
 
 typedef struct {
@@ -294,43 +611,29 @@ typedef struct {
 } fwtProjectData;
 
 void fwtProject(fwtState *state, float left, float right, float top, float bottom) {
-    fwtCommand* cmd = malloc(sizeof(fwtCommand));
-    cmd->type = fwtCommandProject;
-    fwtProjectData* cmdData = malloc(sizeof(fwtProjectData));
-    cmdData->left = left;
-    cmdData->right = right;
-    cmdData->top = top;
-    cmdData->bottom = bottom;
-    cmd->data = cmdData;
-    PushCommand(state, cmd);
+    fwtProjectData data = {
+        .left = left,
+        .right = right,
+        .top = top,
+        .bottom = bottom
+    };
+    PushCommand(state, fwtCommandProject, &data, sizeof(data));
 }
 
 void fwtResetProject(fwtState *state) {
-    fwtCommand* cmd = malloc(sizeof(fwtCommand));
-    cmd->type = fwtCommandResetProject;
-    cmd->data = NULL;
-    PushCommand(state, cmd);
+    PushCommand(state, fwtCommandResetProject, NULL, 0);
 }
 
 void fwtPushTransform(fwtState *state) {
-    fwtCommand* cmd = malloc(sizeof(fwtCommand));
-    cmd->type = fwtCommandPushTransform;
-    cmd->data = NULL;
-    PushCommand(state, cmd);
+    PushCommand(state, fwtCommandPushTransform, NULL, 0);
 }
 
 void fwtPopTransform(fwtState *state) {
-    fwtCommand* cmd = malloc(sizeof(fwtCommand));
-    cmd->type = fwtCommandPopTransform;
-    cmd->data = NULL;
-    PushCommand(state, cmd);
+    PushCommand(state, fwtCommandPopTransform, NULL, 0);
 }
 
 void fwtResetTransform(fwtState *state) {
-    fwtCommand* cmd = malloc(sizeof(fwtCommand));
-    cmd->type = fwtCommandResetTransform;
-    cmd->data = NULL;
-    PushCommand(state, cmd);
+    PushCommand(state, fwtCommandResetTransform, NULL, 0);
 }
 
 typedef struct {
@@ -339,13 +642,11 @@ typedef struct {
 } fwtTranslateData;
 
 void fwtTranslate(fwtState *state, float x, float y) {
-    fwtCommand* cmd = malloc(sizeof(fwtCommand));
-    cmd->type = fwtCommandTranslate;
-    fwtTranslateData* cmdData = malloc(sizeof(fwtTranslateData));
-    cmdData->x = x;
-    cmdData->y = y;
-    cmd->data = cmdData;
-    PushCommand(state, cmd);
+    fwtTranslateData data = {
+        .x = x,
+        .y = y
+    };
+    PushCommand(state, fwtCommandTranslate, &data, sizeof(data));
 }
 
 typedef struct {
@@ -353,12 +654,10 @@ typedef struct {
 } fwtRotateData;
 
 void fwtRotate(fwtState *state, float theta) {
-    fwtCommand* cmd = malloc(sizeof(fwtCommand));
-    cmd->type = fwtCommandRotate;
-    fwtRotateData* cmdData = malloc(sizeof(fwtRotateData));
-    cmdData->theta = theta;
-    cmd->data = cmdData;
-    PushCommand(state, cmd);
+    fwtRotateData data = {
+        .theta = theta
+    };
+    PushCommand(state, fwtCommandRotate, &data, sizeof(data));
 }
 
 typedef struct {
@@ -368,14 +667,12 @@ typedef struct {
 } fwtRotateAtData;
 
 void fwtRotateAt(fwtState *state, float theta, float x, float y) {
-    fwtCommand* cmd = malloc(sizeof(fwtCommand));
-    cmd->type = fwtCommandRotateAt;
-    fwtRotateAtData* cmdData = malloc(sizeof(fwtRotateAtData));
-    cmdData->theta = theta;
-    cmdData->x = x;
-    cmdData->y = y;
-    cmd->data = cmdData;
-    PushCommand(state, cmd);
+    fwtRotateAtData data = {
+        .theta = theta,
+        .x = x,
+        .y = y
+    };
+    PushCommand(state, fwtCommandRotateAt, &data, sizeof(data));
 }
 
 typedef struct {
@@ -384,13 +681,11 @@ typedef struct {
 } fwtScaleData;
 
 void fwtScale(fwtState *state, float sx, float sy) {
-    fwtCommand* cmd = malloc(sizeof(fwtCommand));
-    cmd->type = fwtCommandScale;
-    fwtScaleData* cmdData = malloc(sizeof(fwtScaleData));
-    cmdData->sx = sx;
-    cmdData->sy = sy;
-    cmd->data = cmdData;
-    PushCommand(state, cmd);
+    fwtScaleData data = {
+        .sx = sx,
+        .sy = sy
+    };
+    PushCommand(state, fwtCommandScale, &data, sizeof(data));
 }
 
 typedef struct {
@@ -401,44 +696,33 @@ typedef struct {
 } fwtScaleAtData;
 
 void fwtScaleAt(fwtState *state, float sx, float sy, float x, float y) {
-    fwtCommand* cmd = malloc(sizeof(fwtCommand));
-    cmd->type = fwtCommandScaleAt;
-    fwtScaleAtData* cmdData = malloc(sizeof(fwtScaleAtData));
-    cmdData->sx = sx;
-    cmdData->sy = sy;
-    cmdData->x = x;
-    cmdData->y = y;
-    cmd->data = cmdData;
-    PushCommand(state, cmd);
+    fwtScaleAtData data = {
+        .sx = sx,
+        .sy = sy,
+        .x = x,
+        .y = y
+    };
+    PushCommand(state, fwtCommandScaleAt, &data, sizeof(data));
 }
 
 void fwtResetPipeline(fwtState *state) {
-    fwtCommand* cmd = malloc(sizeof(fwtCommand));
-    cmd->type = fwtCommandResetPipeline;
-    cmd->data = NULL;
-    PushCommand(state, cmd);
+    PushCommand(state, fwtCommandResetPipeline, NULL, 0);
+    UpdateSortKey(state, SORT_KEY_PIPELINE_MASK, SORT_KEY_PIPELINE(0));
 }
 
 typedef struct {
-    void* data;
     int size;
 } fwtSetUniformData;
 
-void fwtSetUniform(fwtState *state, void* data, int size) {
-    fwtCommand* cmd = malloc(sizeof(fwtCommand));
-    cmd->type = fwtCommandSetUniform;
-    fwtSetUniformData* cmdData = malloc(sizeof(fwtSetUniformData));
-    cmdData->data = data;
-    cmdData->size = size;
-    cmd->data = cmdData;
-    PushCommand(state, cmd);
+void fwtSetUniform(fwtState *state, const void* data, int size) {
+    fwtSetUniformData uniform = {
+        .size = size
+    };
+    PushCommandArray(state, fwtCommandSetUniform, &uniform, sizeof(uniform), data, size);
 }
 
 void fwtResetUniform(fwtState *state) {
-    fwtCommand* cmd = malloc(sizeof(fwtCommand));
-    cmd->type = fwtCommandResetUniform;
-    cmd->data = NULL;
-    PushCommand(state, cmd);
+    PushCommand(state, fwtCommandResetUniform, NULL, 0);
 }
 
 typedef struct {
@@ -446,19 +730,16 @@ typedef struct {
 } fwtSetBlendModeData;
 
 void fwtSetBlendMode(fwtState *state, sgp_blend_mode blend_mode) {
-    fwtCommand* cmd = malloc(sizeof(fwtCommand));
-    cmd->type = fwtCommandSetBlendMode;
-    fwtSetBlendModeData* cmdData = malloc(sizeof(fwtSetBlendModeData));
-    cmdData->blend_mode = blend_mode;
-    cmd->data = cmdData;
-    PushCommand(state, cmd);
+    fwtSetBlendModeData data = {
+        .blend_mode = blend_mode
+    };
+    PushCommand(state, fwtCommandSetBlendMode, &data, sizeof(data));
+    UpdateSortKey(state, SORT_KEY_BLEND_MASK, SORT_KEY_BLEND(blend_mode));
 }
 
 void fwtResetBlendMode(fwtState *state) {
-    fwtCommand* cmd = malloc(sizeof(fwtCommand));
-    cmd->type = fwtCommandResetBlendMode;
-    cmd->data = NULL;
-    PushCommand(state, cmd);
+    PushCommand(state, fwtCommandResetBlendMode, NULL, 0);
+    UpdateSortKey(state, SORT_KEY_BLEND_MASK, SORT_KEY_BLEND(SGP_BLENDMODE_NONE));
 }
 
 typedef struct {
@@ -469,43 +750,43 @@ typedef struct {
 } fwtSetColorData;
 
 void fwtSetColor(fwtState *state, float r, float g, float b, float a) {
-    fwtCommand* cmd = malloc(sizeof(fwtCommand));
-    cmd->type = fwtCommandSetColor;
-    fwtSetColorData* cmdData = malloc(sizeof(fwtSetColorData));
-    cmdData->r = r;
-    cmdData->g = g;
-    cmdData->b = b;
-    cmdData->a = a;
-    cmd->data = cmdData;
-    PushCommand(state, cmd);
+    fwtSetColorData data = {
+        .r = r,
+        .g = g,
+        .b = b,
+        .a = a
+    };
+    PushCommand(state, fwtCommandSetColor, &data, sizeof(data));
 }
 
 void fwtResetColor(fwtState *state) {
-    fwtCommand* cmd = malloc(sizeof(fwtCommand));
-    cmd->type = fwtCommandResetColor;
-    cmd->data = NULL;
-    PushCommand(state, cmd);
+    PushCommand(state, fwtCommandResetColor, NULL, 0);
 }
 
+#define TEXTURE_HANDLE(INDEX, GENERATION) (((uint64_t)(GENERATION) << 32) | (uint32_t)(INDEX))
+#define TEXTURE_INDEX(HANDLE) ((uint32_t)(HANDLE))
+#define TEXTURE_GENERATION(HANDLE) ((uint32_t)((HANDLE) >> 32))
+
 typedef struct {
     int channel;
-    fwtTexture* texture;
+    uint32_t texture;
 } fwtSetImageData;
 
 void fwtSetImage(fwtState* state, uint64_t texture_id, int channel) {
-    assert(texture_id);
-    imap_slot_t* slot = imap_lookup(state->textureMap, texture_id);
-    assert(slot);
-    fwtTexture* texture = (fwtTexture*)imap_getval64(state->textureMap, slot);
-    assert(texture);
-
-    fwtCommand* cmd = malloc(sizeof(fwtCommand));
-    cmd->type = fwtCommandSetImage;
-    fwtSetImageData* cmdData = malloc(sizeof(fwtSetImageData));
-    cmdData->channel = channel;
-    cmdData->texture = texture;
-    cmd->data = cmdData;
-    PushCommand(state, cmd);
+    // Handles can go stale when a texture is destroyed or reloaded, fall back to no image
+    if (!fwtIsTextureValid(state, texture_id)) {
+        fwtUnsetImage(state, channel);
+        return;
+    }
+    fwtSetImageData data = {
+        .channel = channel,
+        .texture = TEXTURE_INDEX(texture_id)
+    };
+    PushCommand(state, fwtCommandSetImage, &data, sizeof(data));
+    // Packed textures sort by their atlas page so sprites sharing a page end up adjacent
+    uint32_t page = state->textures[data.texture].page;
+    if (!channel)
+        UpdateSortKey(state, SORT_KEY_TEXTURE_MASK, SORT_KEY_TEXTURE(page ? page : data.texture + 1));
 }
 
 typedef struct {
@@ -513,12 +794,12 @@ typedef struct {
 } fwtUnsetImageData;
 
 void fwtUnsetImage(fwtState *state, int channel) {
-    fwtCommand* cmd = malloc(sizeof(fwtCommand));
-    cmd->type = fwtCommandUnsetImage;
-    fwtUnsetImageData* cmdData = malloc(sizeof(fwtUnsetImageData));
-    cmdData->channel = channel;
-    cmd->data = cmdData;
-    PushCommand(state, cmd);
+    fwtUnsetImageData data = {
+        .channel = channel
+    };
+    PushCommand(state, fwtCommandUnsetImage, &data, sizeof(data));
+    if (!channel)
+        UpdateSortKey(state, SORT_KEY_TEXTURE_MASK, SORT_KEY_TEXTURE(0));
 }
 
 typedef struct {
@@ -526,12 +807,12 @@ typedef struct {
 } fwtResetImageData;
 
 void fwtResetImage(fwtState *state, int channel) {
-    fwtCommand* cmd = malloc(sizeof(fwtCommand));
-    cmd->type = fwtCommandResetImage;
-    fwtResetImageData* cmdData = malloc(sizeof(fwtResetImageData));
-    cmdData->channel = channel;
-    cmd->data = cmdData;
-    PushCommand(state, cmd);
+    fwtResetImageData data = {
+        .channel = channel
+    };
+    PushCommand(state, fwtCommandResetImage, &data, sizeof(data));
+    if (!channel)
+        UpdateSortKey(state, SORT_KEY_TEXTURE_MASK, SORT_KEY_TEXTURE(0));
 }
 
 typedef struct {
@@ -539,12 +820,10 @@ typedef struct {
 } fwtResetSamplerData;
 
 void fwtResetSampler(fwtState *state, int channel) {
-    fwtCommand* cmd = malloc(sizeof(fwtCommand));
-    cmd->type = fwtCommandResetSampler;
-    fwtResetSamplerData* cmdData = malloc(sizeof(fwtResetSamplerData));
-    cmdData->channel = channel;
-    cmd->data = cmdData;
-    PushCommand(state, cmd);
+    fwtResetSamplerData data = {
+        .channel = channel
+    };
+    PushCommand(state, fwtCommandResetSampler, &data, sizeof(data));
 }
 
 typedef struct {
@@ -555,22 +834,17 @@ typedef struct {
 } fwtViewportData;
 
 void fwtViewport(fwtState *state, int x, int y, int w, int h) {
-    fwtCommand* cmd = malloc(sizeof(fwtCommand));
-    cmd->type = fwtCommandViewport;
-    fwtViewportData* cmdData = malloc(sizeof(fwtViewportData));
-    cmdData->x = x;
-    cmdData->y = y;
-    cmdData->w = w;
-    cmdData->h = h;
-    cmd->data = cmdData;
-    PushCommand(state, cmd);
+    fwtViewportData data = {
+        .x = x,
+        .y = y,
+        .w = w,
+        .h = h
+    };
+    PushCommand(state, fwtCommandViewport, &data, sizeof(data));
 }
 
 void fwtResetViewport(fwtState *state) {
-    fwtCommand* cmd = malloc(sizeof(fwtCommand));
-    cmd->type = fwtCommandResetViewport;
-    cmd->data = NULL;
-    PushCommand(state, cmd);
+    PushCommand(state, fwtCommandResetViewport, NULL, 0);
 }
 
 typedef struct {
@@ -581,51 +855,36 @@ typedef struct {
 } fwtScissorData;
 
 void fwtScissor(fwtState *state, int x, int y, int w, int h) {
-    fwtCommand* cmd = malloc(sizeof(fwtCommand));
-    cmd->type = fwtCommandScissor;
-    fwtScissorData* cmdData = malloc(sizeof(fwtScissorData));
-    cmdData->x = x;
-    cmdData->y = y;
-    cmdData->w = w;
-    cmdData->h = h;
-    cmd->data = cmdData;
-    PushCommand(state, cmd);
+    fwtScissorData data = {
+        .x = x,
+        .y = y,
+        .w = w,
+        .h = h
+    };
+    PushCommand(state, fwtCommandScissor, &data, sizeof(data));
 }
 
 void fwtResetScissor(fwtState *state) {
-    fwtCommand* cmd = malloc(sizeof(fwtCommand));
-    cmd->type = fwtCommandResetScissor;
-    cmd->data = NULL;
-    PushCommand(state, cmd);
+    PushCommand(state, fwtCommandResetScissor, NULL, 0);
 }
 
 void fwtResetState(fwtState *state) {
-    fwtCommand* cmd = malloc(sizeof(fwtCommand));
-    cmd->type = fwtCommandResetState;
-    cmd->data = NULL;
-    PushCommand(state, cmd);
+    PushCommand(state, fwtCommandResetState, NULL, 0);
 }
 
 void fwtClear(fwtState *state) {
-    fwtCommand* cmd = malloc(sizeof(fwtCommand));
-    cmd->type = fwtCommandClear;
-    cmd->data = NULL;
-    PushCommand(state, cmd);
+    PushCommand(state, fwtCommandClear, NULL, 0);
 }
 
 typedef struct {
-    sgp_point* points;
     int count;
 } fwtDrawPointsData;
 
-void fwtDrawPoints(fwtState *state, sgp_point* points, int count) {
-    fwtCommand* cmd = malloc(sizeof(fwtCommand));
-    cmd->type = fwtCommandDrawPoints;
-    fwtDrawPointsData* cmdData = malloc(sizeof(fwtDrawPointsData));
-    cmdData->points = points;
-    cmdData->count = count;
-    cmd->data = cmdData;
-    PushCommand(state, cmd);
+void fwtDrawPoints(fwtState *state, const sgp_point* points, int count) {
+    fwtDrawPointsData data = {
+        .count = count
+    };
+    PushCommandArray(state, fwtCommandDrawPoints, &data, sizeof(data), points, count * sizeof(sgp_point));
 }
 
 typedef struct {
@@ -634,28 +893,22 @@ typedef struct {
 } fwtDrawPointData;
 
 void fwtDrawPoint(fwtState *state, float x, float y) {
-    fwtCommand* cmd = malloc(sizeof(fwtCommand));
-    cmd->type = fwtCommandDrawPoint;
-    fwtDrawPointData* cmdData = malloc(sizeof(fwtDrawPointData));
-    cmdData->x = x;
-    cmdData->y = y;
-    cmd->data = cmdData;
-    PushCommand(state, cmd);
+    fwtDrawPointData data = {
+        .x = x,
+        .y = y
+    };
+    PushCommand(state, fwtCommandDrawPoint, &data, sizeof(data));
 }
 
 typedef struct {
-    sgp_line* lines;
     int count;
 } fwtDrawLinesData;
 
-void fwtDrawLines(fwtState *state, sgp_line* lines, int count) {
-    fwtCommand* cmd = malloc(sizeof(fwtCommand));
-    cmd->type = fwtCommandDrawLines;
-    fwtDrawLinesData* cmdData = malloc(sizeof(fwtDrawLinesData));
-    cmdData->lines = lines;
-    cmdData->count = count;
-    cmd->data = cmdData;
-    PushCommand(state, cmd);
+void fwtDrawLines(fwtState *state, const sgp_line* lines, int count) {
+    fwtDrawLinesData data = {
+        .count = count
+    };
+    PushCommandArray(state, fwtCommandDrawLines, &data, sizeof(data), lines, count * sizeof(sgp_line));
 }
 
 typedef struct {
@@ -666,45 +919,35 @@ typedef struct {
 } fwtDrawLineData;
 
 void fwtDrawLine(fwtState *state, float ax, float ay, float bx, float by) {
-    fwtCommand* cmd = malloc(sizeof(fwtCommand));
-    cmd->type = fwtCommandDrawLine;
-    fwtDrawLineData* cmdData = malloc(sizeof(fwtDrawLineData));
-    cmdData->ax = ax;
-    cmdData->ay = ay;
-    cmdData->bx = bx;
-    cmdData->by = by;
-    cmd->data = cmdData;
-    PushCommand(state, cmd);
+    fwtDrawLineData data = {
+        .ax = ax,
+        .ay = ay,
+        .bx = bx,
+        .by = by
+    };
+    PushCommand(state, fwtCommandDrawLine, &data, sizeof(data));
 }
 
 typedef struct {
-    sgp_point* points;
     int count;
 } fwtDrawLinesStripData;
 
-void fwtDrawLinesStrip(fwtState *state, sgp_point* points, int count) {
-    fwtCommand* cmd = malloc(sizeof(fwtCommand));
-    cmd->type = fwtCommandDrawLinesStrip;
-    fwtDrawLinesStripData* cmdData = malloc(sizeof(fwtDrawLinesStripData));
-    cmdData->points = points;
-    cmdData->count = count;
-    cmd->data = cmdData;
-    PushCommand(state, cmd);
+void fwtDrawLinesStrip(fwtState *state, const sgp_point* points, int count) {
+    fwtDrawLinesStripData data = {
+        .count = count
+    };
+    PushCommandArray(state, fwtCommandDrawLinesStrip, &data, sizeof(data), points, count * sizeof(sgp_point));
 }
 
 typedef struct {
-    sgp_triangle* triangles;
     int count;
 } fwtDrawFilledTrianglesData;
 
-void fwtDrawFilledTriangles(fwtState *state, sgp_triangle* triangles, int count) {
-    fwtCommand* cmd = malloc(sizeof(fwtCommand));
-    cmd->type = fwtCommandDrawFilledTriangles;
-    fwtDrawFilledTrianglesData* cmdData = malloc(sizeof(fwtDrawFilledTrianglesData));
-    cmdData->triangles = triangles;
-    cmdData->count = count;
-    cmd->data = cmdData;
-    PushCommand(state, cmd);
+void fwtDrawFilledTriangles(fwtState *state, const sgp_triangle* triangles, int count) {
+    fwtDrawFilledTrianglesData data = {
+        .count = count
+    };
+    PushCommandArray(state, fwtCommandDrawFilledTriangles, &data, sizeof(data), triangles, count * sizeof(sgp_triangle));
 }
 
 typedef struct {
@@ -717,47 +960,37 @@ typedef struct {
 } fwtDrawFilledTriangleData;
 
 void fwtDrawFilledTriangle(fwtState *state, float ax, float ay, float bx, float by, float cx, float cy) {
-    fwtCommand* cmd = malloc(sizeof(fwtCommand));
-    cmd->type = fwtCommandDrawFilledTriangle;
-    fwtDrawFilledTriangleData* cmdData = malloc(sizeof(fwtDrawFilledTriangleData));
-    cmdData->ax = ax;
-    cmdData->ay = ay;
-    cmdData->bx = bx;
-    cmdData->by = by;
-    cmdData->cx = cx;
-    cmdData->cy = cy;
-    cmd->data = cmdData;
-    PushCommand(state, cmd);
+    fwtDrawFilledTriangleData data = {
+        .ax = ax,
+        .ay = ay,
+        .bx = bx,
+        .by = by,
+        .cx = cx,
+        .cy = cy
+    };
+    PushCommand(state, fwtCommandDrawFilledTriangle, &data, sizeof(data));
 }
 
 typedef struct {
-    sgp_point* points;
     int count;
 } fwtDrawFilledTrianglesStripData;
 
-void fwtDrawFilledTrianglesStrip(fwtState *state, sgp_point* points, int count) {
-    fwtCommand* cmd = malloc(sizeof(fwtCommand));
-    cmd->type = fwtCommandDrawFilledTrianglesStrip;
-    fwtDrawFilledTrianglesStripData* cmdData = malloc(sizeof(fwtDrawFilledTrianglesStripData));
-    cmdData->points = points;
-    cmdData->count = count;
-    cmd->data = cmdData;
-    PushCommand(state, cmd);
+void fwtDrawFilledTrianglesStrip(fwtState *state, const sgp_point* points, int count) {
+    fwtDrawFilledTrianglesStripData data = {
+        .count = count
+    };
+    PushCommandArray(state, fwtCommandDrawFilledTrianglesStrip, &data, sizeof(data), points, count * sizeof(sgp_point));
 }
 
 typedef struct {
-    sgp_rect* rects;
     int count;
 } fwtDrawFilledRectsData;
 
-void fwtDrawFilledRects(fwtState *state, sgp_rect* rects, int count) {
-    fwtCommand* cmd = malloc(sizeof(fwtCommand));
-    cmd->type = fwtCommandDrawFilledRects;
-    fwtDrawFilledRectsData* cmdData = malloc(sizeof(fwtDrawFilledRectsData));
-    cmdData->rects = rects;
-    cmdData->count = count;
-    cmd->data = cmdData;
-    PushCommand(state, cmd);
+void fwtDrawFilledRects(fwtState *state, const sgp_rect* rects, int count) {
+    fwtDrawFilledRectsData data = {
+        .count = count
+    };
+    PushCommandArray(state, fwtCommandDrawFilledRects, &data, sizeof(data), rects, count * sizeof(sgp_rect));
 }
 
 typedef struct {
@@ -768,32 +1001,26 @@ typedef struct {
 } fwtDrawFilledRectData;
 
 void fwtDrawFilledRect(fwtState *state, float x, float y, float w, float h) {
-    fwtCommand* cmd = malloc(sizeof(fwtCommand));
-    cmd->type = fwtCommandDrawFilledRect;
-    fwtDrawFilledRectData* cmdData = malloc(sizeof(fwtDrawFilledRectData));
-    cmdData->x = x;
-    cmdData->y = y;
-    cmdData->w = w;
-    cmdData->h = h;
-    cmd->data = cmdData;
-    PushCommand(state, cmd);
+    fwtDrawFilledRectData data = {
+        .x = x,
+        .y = y,
+        .w = w,
+        .h = h
+    };
+    PushCommand(state, fwtCommandDrawFilledRect, &data, sizeof(data));
 }
 
 typedef struct {
     int channel;
-    sgp_textured_rect* rects;
     int count;
 } fwtDrawTexturedRectsData;
 
-void fwtDrawTexturedRects(fwtState *state, int channel, sgp_textured_rect* rects, int count) {
-    fwtCommand* cmd = malloc(sizeof(fwtCommand));
-    cmd->type = fwtCommandDrawTexturedRects;
-    fwtDrawTexturedRectsData* cmdData = malloc(sizeof(fwtDrawTexturedRectsData));
-    cmdData->channel = channel;
-    cmdData->rects = rects;
-    cmdData->count = count;
-    cmd->data = cmdData;
-    PushCommand(state, cmd);
+void fwtDrawTexturedRects(fwtState *state, int channel, const sgp_textured_rect* rects, int count) {
+    fwtDrawTexturedRectsData data = {
+        .channel = channel,
+        .count = count
+    };
+    PushCommandArray(state, fwtCommandDrawTexturedRects, &data, sizeof(data), rects, count * sizeof(sgp_textured_rect));
 }
 
 typedef struct {
@@ -803,367 +1030,1049 @@ typedef struct {
 } fwtDrawTexturedRectData;
 
 void fwtDrawTexturedRect(fwtState *state, int channel, sgp_rect dest_rect, sgp_rect src_rect) {
-    fwtCommand* cmd = malloc(sizeof(fwtCommand));
-    cmd->type = fwtCommandDrawTexturedRect;
-    fwtDrawTexturedRectData* cmdData = malloc(sizeof(fwtDrawTexturedRectData));
-    cmdData->channel = channel;
-    cmdData->dest_rect = dest_rect;
-    cmdData->src_rect = src_rect;
-    cmd->data = cmdData;
-    PushCommand(state, cmd);
+    fwtDrawTexturedRectData data = {
+        .channel = channel,
+        .dest_rect = dest_rect,
+        .src_rect = src_rect
+    };
+    PushCommand(state, fwtCommandDrawTexturedRect, &data, sizeof(data));
 }
 
-typedef struct {
-    ezImage *image;
-    const char *name;
-} fwtCreateTextureData;
-
-void fwtCreateTexture(fwtState *state, const char *name, ezImage *image) {
-    fwtCommand* cmd = malloc(sizeof(fwtCommand));
-    cmd->type = fwtCommandDrawTexturedRect;
-    fwtCreateTextureData* cmdData = malloc(sizeof(fwtCreateTextureData));
-    cmdData->name = name;
-    cmdData->image = image;
-    cmd->data = cmdData;
-    PushCommand(state, cmd);
+// Growing the table can move it under a worker reading it, see fwtBeginThreadCommands
+static void AssertTextureTableWritable(fwtState *state) {
+    assert(pthread_equal(pthread_self(), state->mainThread));
+    assert(!__atomic_load_n(&state->threadRecorders, __ATOMIC_ACQUIRE));
 }
 
-#if !defined(FWT_SCENE)
-static void FreeCommand(fwtCommand* command) {
-    fwtCommandType type = command->type;
-    switch
-(type) {
-    case fwtCommandProject: {
-        fwtProjectData* data = (fwtProjectData*)command->data;
-        free(data);
-        break;
-    }
-    case fwtCommandTranslate: {
-        fwtTranslateData* data = (fwtTranslateData*)command->data;
-        free(data);
-        break;
-    }
-    case fwtCommandRotate: {
-        fwtRotateData* data = (fwtRotateData*)command->data;
-        free(data);
-        break;
-    }
-    case fwtCommandRotateAt: {
-        fwtRotateAtData* data = (fwtRotateAtData*)command->data;
-        free(data);
-        break;
-    }
-    case fwtCommandScale: {
-        fwtScaleData* data = (fwtScaleData*)command->data;
-        free(data);
-        break;
-    }
-    case fwtCommandScaleAt: {
-        fwtScaleAtData* data = (fwtScaleAtData*)command->data;
-        free(data);
-        break;
-    }
-    case fwtCommandSetUniform: {
-        fwtSetUniformData* data = (fwtSetUniformData*)command->data;
-        free(data);
-        break;
-    }
-    case fwtCommandSetBlendMode: {
-        fwtSetBlendModeData* data = (fwtSetBlendModeData*)command->data;
-        free(data);
-        break;
-    }
-    case fwtCommandSetColor: {
-        fwtSetColorData* data = (fwtSetColorData*)command->data;
-        free(data);
-        break;
-    }
-    case fwtCommandSetImage: {
-        fwtSetImageData* data = (fwtSetImageData*)command->data;
-        free(data);
-        break;
-    }
-    case fwtCommandUnsetImage: {
-        fwtUnsetImageData* data = (fwtUnsetImageData*)command->data;
-        free(data);
-        break;
-    }
-    case fwtCommandResetImage: {
-        fwtResetImageData* data = (fwtResetImageData*)command->data;
-        free(data);
-        break;
-    }
-    case fwtCommandResetSampler: {
-        fwtResetSamplerData* data = (fwtResetSamplerData*)command->data;
-        free(data);
-        break;
-    }
-    case fwtCommandViewport: {
-        fwtViewportData* data = (fwtViewportData*)command->data;
-        free(data);
-        break;
-    }
-    case fwtCommandScissor: {
-        fwtScissorData* data = (fwtScissorData*)command->data;
-        free(data);
-        break;
-    }
-    case fwtCommandDrawPoints: {
-        fwtDrawPointsData* data = (fwtDrawPointsData*)command->data;
-        free(data);
-        break;
-    }
-    case fwtCommandDrawPoint: {
-        fwtDrawPointData* data = (fwtDrawPointData*)command->data;
-        free(data);
-        break;
-    }
-    case fwtCommandDrawLines: {
-        fwtDrawLinesData* data = (fwtDrawLinesData*)command->data;
-        free(data);
-        break;
-    }
-    case fwtCommandDrawLine: {
-        fwtDrawLineData* data = (fwtDrawLineData*)command->data;
-        free(data);
-        break;
-    }
-    case fwtCommandDrawLinesStrip: {
-        fwtDrawLinesStripData* data = (fwtDrawLinesStripData*)command->data;
-        free(data);
-        break;
-    }
-    case fwtCommandDrawFilledTriangles: {
-        fwtDrawFilledTrianglesData* data = (fwtDrawFilledTrianglesData*)command->data;
-        free(data);
-        break;
-    }
-    case fwtCommandDrawFilledTriangle: {
-        fwtDrawFilledTriangleData* data = (fwtDrawFilledTriangleData*)command->data;
-        free(data);
-        break;
-    }
-    case fwtCommandDrawFilledTrianglesStrip: {
-        fwtDrawFilledTrianglesStripData* data = (fwtDrawFilledTrianglesStripData*)command->data;
-        free(data);
-        break;
-    }
-    case fwtCommandDrawFilledRects: {
-        fwtDrawFilledRectsData* data = (fwtDrawFilledRectsData*)command->data;
-        free(data);
-        break;
-    }
-    case fwtCommandDrawFilledRect: {
-        fwtDrawFilledRectData* data = (fwtDrawFilledRectData*)command->data;
-        free(data);
-        break;
-    }
-    case fwtCommandDrawTexturedRects: {
-        fwtDrawTexturedRectsData* data = (fwtDrawTexturedRectsData*)command->data;
-        free(data);
-        break;
-    }
-    case fwtCommandDrawTexturedRect: {
-        fwtDrawTexturedRectData* data = (fwtDrawTexturedRectData*)command->data;
-        free(data);
-        break;
-    }
-    default:
-        break;
+#define TEXTURE_NAME_BUCKET(NAME, MASK) ((uint32_t)((NAME) ^ ((NAME) >> 32)) & (MASK))
+
+// The bucket holding `name`, or the empty bucket it would go in
+static uint32_t* FindTextureName(fwtState *state, uint64_t name) {
+    uint32_t mask = state->textureNameCapacity - 1;
+    for (uint32_t i = TEXTURE_NAME_BUCKET(name, mask);; i = (i + 1) & mask) {
+        uint32_t entry = state->textureNames[i];
+        if (!entry || state->textureSlots[entry - 1].name == name)
+            return &state->textureNames[i];
     }
-    free(command);
 }
 
-static void ProcessCommand(fwtCommand* command) {
-    fwtCommandType type = command->type;
-    switch (type) {
-    case fwtCommandProject: {
-        fwtProjectData* data = (fwtProjectData*)command->data;
-        sgp_project(data->left, data->right, data->top, data->bottom);
-        break;
-    }
-    case fwtCommandResetProject:
-        sgp_reset_project();
-        break;
-    case fwtCommandPushTransform:
-        sgp_push_transform();
-        break;
-    case fwtCommandPopTransform:
-        sgp_pop_transform();
-        break;
-    case fwtCommandResetTransform:
-        sgp_reset_transform();
-        break;
-    case fwtCommandTranslate: {
-        fwtTranslateData* data = (fwtTranslateData*)command->data;
-        sgp_translate(data->x, data->y);
-        break;
-    }
-    case fwtCommandRotate: {
-        fwtRotateData* data = (fwtRotateData*)command->data;
-        sgp_rotate(data->theta);
-        break;
-    }
-    case fwtCommandRotateAt: {
-        fwtRotateAtData* data = (fwtRotateAtData*)command->data;
-        sgp_rotate_at(data->theta, data->x, data->y);
-        break;
-    }
-    case fwtCommandScale: {
-        fwtScaleData* data = (fwtScaleData*)command->data;
-        sgp_scale(data->sx, data->sy);
-        break;
-    }
-    case fwtCommandScaleAt: {
-        fwtScaleAtData* data = (fwtScaleAtData*)command->data;
-        sgp_scale_at(data->sx, data->sy, data->x, data->y);
-        break;
-    }
-    case fwtCommandResetPipeline:
-        sgp_reset_pipeline();
-        break;
-    case fwtCommandSetUniform: {
-        fwtSetUniformData* data = (fwtSetUniformData*)command->data;
-        sgp_set_uniform(data->data, data->size);
-        break;
-    }
-    case fwtCommandResetUniform:
-        sgp_reset_uniform();
-        break;
-    case fwtCommandSetBlendMode: {
-        fwtSetBlendModeData* data = (fwtSetBlendModeData*)command->data;
-        sgp_set_blend_mode(data->blend_mode);
-        break;
-    }
-    case fwtCommandResetBlendMode:
-        sgp_reset_blend_mode();
-        break;
-    case fwtCommandSetColor: {
-        fwtSetColorData* data = (fwtSetColorData*)command->data;
-        sgp_set_color(data->r, data->g, data->b, data->a);
-        break;
-    }
-    case fwtCommandResetColor:
-        sgp_reset_color();
-        break;
-    case fwtCommandSetImage: {
-        fwtSetImageData* data = (fwtSetImageData*)command->data;
-        sgp_set_image(data->channel, data->texture->internal);
-        break;
-    }
-    case fwtCommandUnsetImage: {
-        fwtUnsetImageData* data = (fwtUnsetImageData*)command->data;
-        sgp_unset_image(data->channel);
-        break;
+static void InsertTextureName(fwtState *state, uint32_t index) {
+    uint64_t name = state->textureSlots[index].name;
+    if (!name)
+        return;
+    // Kept under 3/4 full so probe runs stay short
+    if ((state->textureNameCount + 1) * 4 > state->textureNameCapacity * 3) {
+        uint32_t *names = state->textureNames, capacity = state->textureNameCapacity;
+        state->textureNameCapacity = capacity ? capacity * 2 : 64;
+        state->textureNames = calloc(state->textureNameCapacity, sizeof(uint32_t));
+        assert(state->textureNames);
+        for (uint32_t i = 0; i < capacity; i++)
+            if (names[i])
+                *FindTextureName(state, state->textureSlots[names[i] - 1].name) = names[i];
+        free(names);
+    }
+    uint32_t *bucket = FindTextureName(state, name);
+    if (!*bucket)
+        state->textureNameCount++;
+    // A newer texture with the same name replaces the older one in lookups
+    *bucket = index + 1;
+}
+
+static void RemoveTextureName(fwtState *state, uint32_t index) {
+    uint64_t name = state->textureSlots[index].name;
+    if (!name || !state->textureNameCount)
+        return;
+    uint32_t *bucket = FindTextureName(state, name);
+    if (*bucket != index + 1)
+        return;
+    uint32_t mask = state->textureNameCapacity - 1;
+    uint32_t hole = (uint32_t)(bucket - state->textureNames);
+    *bucket = 0;
+    state->textureNameCount--;
+    // Entries further along the probe run move back into the hole unless they'd land
+    // before their own bucket, so lookups never stop short of them
+    for (uint32_t i = (hole + 1) & mask; state->textureNames[i]; i = (i + 1) & mask) {
+        uint32_t home = TEXTURE_NAME_BUCKET(state->textureSlots[state->textureNames[i] - 1].name, mask);
+        if (((i - home) & mask) >= ((i - hole) & mask)) {
+            state->textureNames[hole] = state->textureNames[i];
+            state->textureNames[i] = 0;
+            hole = i;
+        }
     }
-    case fwtCommandResetImage: {
-        fwtResetImageData* data = (fwtResetImageData*)command->data;
-        sgp_reset_image(data->channel);
-        break;
+}
+
+// Slots are handed out at record time so the handle is usable straight away, the
+// sg_image itself is only created (and destroyed) when the command is replayed.
+static uint32_t NewTextureSlot(fwtState *state, uint64_t name) {
+    AssertTextureTableWritable(state);
+    uint32_t index;
+    if (state->textureFreeList) {
+        index = state->textureFreeList - 1;
+        state->textureFreeList = state->textureSlots[index].nextFree;
+    } else {
+        if (state->textureCount == state->textureCapacity) {
+            state->textureCapacity = state->textureCapacity ? state->textureCapacity * 2 : 16;
+            state->textures = realloc(state->textures, state->textureCapacity * sizeof(fwtTexture));
+            state->textureSlots = realloc(state->textureSlots, state->textureCapacity * sizeof(fwtTextureSlot));
+            assert(state->textures && state->textureSlots);
+        }
+        index = state->textureCount++;
+        state->textureSlots[index].generation = 1;
     }
-    case fwtCommandResetSampler: {
-        fwtResetSamplerData* data = (fwtResetSamplerData*)command->data;
-        sgp_reset_sampler(data->channel);
-        break;
+    state->textureSlots[index].name = name;
+    state->textureSlots[index].contentHash = 0;
+    state->textureSlots[index].nextFree = 0;
+    memset(&state->textures[index], 0, sizeof(fwtTexture));
+    InsertTextureName(state, index);
+    return index;
+}
+
+static void FreeTextureSlot(fwtState *state, uint32_t index) {
+    AssertTextureTableWritable(state);
+    RemoveTextureName(state, index);
+    fwtTextureSlot *slot = &state->textureSlots[index];
+    slot->name = 0;
+    if (!++slot->generation)
+        slot->generation = 1;
+    // The destroy record (and any SetImage recorded before it) still refer to this index
+    slot->nextFree = state->texturePendingFree;
+    state->texturePendingFree = index + 1;
+}
+
+static void RecycleTextureSlots(fwtState *state) {
+    while (state->texturePendingFree) {
+        uint32_t index = state->texturePendingFree - 1;
+        state->texturePendingFree = state->textureSlots[index].nextFree;
+        state->textureSlots[index].nextFree = state->textureFreeList;
+        state->textureFreeList = index + 1;
     }
-    case fwtCommandViewport: {
-        fwtViewportData* data = (fwtViewportData*)command->data;
-        sgp_viewport(data->x, data->y, data->w, data->h);
-        break;
+}
+
+bool fwtIsTextureValid(fwtState *state, uint64_t texture_id) {
+    uint32_t index = TEXTURE_INDEX(texture_id);
+    return texture_id &&
+           index < state->textureCount &&
+           state->textureSlots[index].generation == TEXTURE_GENERATION(texture_id);
+}
+
+typedef struct {
+    ezImage *image;
+    uint32_t texture;
+} fwtCreateTextureData;
+
+uint64_t fwtCreateTexture(fwtState *state, const char *name, ezImage *image) {
+    uint32_t index = NewTextureSlot(state, MurmurHash((void*)name, strlen(name), 0));
+    fwtCreateTextureData data = {
+        .image = image,
+        .texture = index
+    };
+    PushCommand(state, fwtCommandCreateTexture, &data, sizeof(data));
+    return TEXTURE_HANDLE(index, state->textureSlots[index].generation);
+}
+
+static int FindPackEntry(fwtTexturePack *pack, uint64_t name) {
+    int lo = 0, hi = (int)pack->count - 1;
+    while (lo <= hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (pack->entries[mid].name == name)
+            return mid;
+        if (pack->entries[mid].name < name)
+            lo = mid + 1;
+        else
+            hi = mid - 1;
     }
-    case fwtCommandResetViewport:
-        sgp_reset_viewport();
-        break;
-    case fwtCommandScissor: {
-        fwtScissorData* data = (fwtScissorData*)command->data;
-        sgp_scissor(data->x, data->y, data->w, data->h);
-        break;
+    return -1;
+}
+
+typedef struct {
+    uint32_t texture;
+    uint32_t entry;
+} fwtCreatePackedTextureData;
+
+struct fwtTextureJob {
+    fwtTextureJob *next;
+    uint64_t texture;
+    uint64_t contentHash;
+    bool reload; // Update the existing texture, skipped if `contentHash` still matches
+    int *pixels;
+    int w, h;
+    char path[MAX_PATH];
+};
+
+static void QueueTextureJob(fwtTextureLoader *loader, fwtTextureJob *job) {
+    pthread_mutex_lock(&loader->lock);
+    if (loader->pendingTail)
+        loader->pendingTail->next = job;
+    else
+        loader->pending = job;
+    loader->pendingTail = job;
+    pthread_cond_signal(&loader->wake);
+    pthread_mutex_unlock(&loader->lock);
+}
+
+// Returns a handle straight away, the image is decoded on a loader thread and uploaded
+// by the main thread within the per-frame budget. Until then the texture draws as a
+// placeholder. Like fwtCreateTexture this must be called from the main thread.
+uint64_t fwtLoadTextureAsync(fwtState *state, const char *name) {
+    uint64_t hash = MurmurHash((void*)name, strlen(name), 0);
+    uint32_t index = NewTextureSlot(state, hash);
+    // Textures cooked into the asset pack skip the loader threads entirely
+    int entry = FindPackEntry(&state->texturePack, hash);
+    if (entry != -1) {
+        fwtCreatePackedTextureData data = {
+            .texture = index,
+            .entry = (uint32_t)entry
+        };
+        PushCommand(state, fwtCommandCreatePackedTexture, &data, sizeof(data));
+        return TEXTURE_HANDLE(index, state->textureSlots[index].generation);
+    }
+
+    fwtTextureJob *job = calloc(1, sizeof(fwtTextureJob));
+    assert(job);
+    job->texture = TEXTURE_HANDLE(index, state->textureSlots[index].generation);
+#if defined(FWT_ASSETS_PATH)
+    snprintf(job->path, MAX_PATH, "%s/%s", FWT_ASSETS_PATH, name);
+#else
+    snprintf(job->path, MAX_PATH, "%s", name);
+#endif
+    QueueTextureJob(&state->textureLoader, job);
+    return job->texture;
+}
+
+// Lowest y a `w` x `h` rect fits at when its left edge sits on skyline node `index`, -1 if it doesn't
+static int SkylineFit(fwtAtlasPage *page, int index, int w, int h) {
+    if (page->nodes[index].x + w > DEFAULT_ATLAS_PAGE_SIZE)
+        return -1;
+    int y = 0;
+    for (int i = index, remaining = w; remaining > 0; remaining -= page->nodes[i++].w) {
+        if (page->nodes[i].y > y)
+            y = page->nodes[i].y;
+        if (y + h > DEFAULT_ATLAS_PAGE_SIZE)
+            return -1;
+    }
+    return y;
+}
+
+// Skyline bottom-left packing, picks the position that keeps the skyline lowest
+static bool SkylinePack(fwtAtlasPage *page, int w, int h, int *x, int *y) {
+    int best = -1, bestBottom = DEFAULT_ATLAS_PAGE_SIZE + 1, bestWidth = 0;
+    for (int i = 0; i < page->nodeCount; i++) {
+        int fit = SkylineFit(page, i, w, h);
+        if (fit < 0)
+            continue;
+        if (fit + h < bestBottom || (fit + h == bestBottom && page->nodes[i].w < bestWidth)) {
+            best = i;
+            bestBottom = fit + h;
+            bestWidth = page->nodes[i].w;
+        }
     }
-    case fwtCommandResetScissor:
-        sgp_reset_scissor();
-        break;
-    case fwtCommandResetState:
-        sgp_reset_state();
-        break;
-    case fwtCommandClear:
-        sgp_clear();
-        break;
-    case fwtCommandDrawPoints: {
-        fwtDrawPointsData* data = (fwtDrawPointsData*)command->data;
-        sgp_draw_points(data->points, data->count);
-        break;
-    }
-    case fwtCommandDrawPoint: {
-        fwtDrawPointData* data = (fwtDrawPointData*)command->data;
-        sgp_draw_point(data->x, data->y);
-        break;
-    }
-    case fwtCommandDrawLines: {
-        fwtDrawLinesData* data = (fwtDrawLinesData*)command->data;
-        sgp_draw_lines(data->lines, data->count);
-        break;
-    }
-    case fwtCommandDrawLine: {
-        fwtDrawLineData* data = (fwtDrawLineData*)command->data;
-        sgp_draw_line(data->ax, data->ay, data->bx, data->by);
-        break;
-    }
-    case fwtCommandDrawLinesStrip: {
-        fwtDrawLinesStripData* data = (fwtDrawLinesStripData*)command->data;
-        sgp_draw_lines_strip(data->points, data->count);
-        break;
-    }
-    case fwtCommandDrawFilledTriangles: {
-        fwtDrawFilledTrianglesData* data = (fwtDrawFilledTrianglesData*)command->data;
-        sgp_draw_filled_triangles(data->triangles, data->count);
-        break;
-    }
-    case fwtCommandDrawFilledTriangle: {
-        fwtDrawFilledTriangleData* data = (fwtDrawFilledTriangleData*)command->data;
-        sgp_draw_filled_triangle(data->ax, data->ay, data->bx, data->by, data->cx, data->cy);
-        break;
-    }
-    case fwtCommandDrawFilledTrianglesStrip: {
-        fwtDrawFilledTrianglesStripData* data = (fwtDrawFilledTrianglesStripData*)command->data;
-        sgp_draw_filled_triangles_strip(data->points, data->count);
-        break;
-    }
-    case fwtCommandDrawFilledRects: {
-        fwtDrawFilledRectsData* data = (fwtDrawFilledRectsData*)command->data;
-        sgp_draw_filled_rects(data->rects, data->count);
-        break;
+    if (best == -1)
+        return false;
+    *x = page->nodes[best].x;
+    *y = bestBottom - h;
+
+    if (page->nodeCount == page->nodeCapacity) {
+        page->nodeCapacity *= 2;
+        page->nodes = realloc(page->nodes, page->nodeCapacity * sizeof(fwtSkylineNode));
+        assert(page->nodes);
+    }
+    fwtSkylineNode *nodes = page->nodes;
+    memmove(&nodes[best + 1], &nodes[best], (page->nodeCount - best) * sizeof(fwtSkylineNode));
+    nodes[best] = (fwtSkylineNode) {.x = *x, .y = bestBottom, .w = w};
+    page->nodeCount++;
+
+    // Trim the nodes the new one now covers
+    for (int i = best + 1; i < page->nodeCount; i++) {
+        int overlap = nodes[i - 1].x + nodes[i - 1].w - nodes[i].x;
+        if (overlap <= 0)
+            break;
+        nodes[i].x += overlap;
+        nodes[i].w -= overlap;
+        if (nodes[i].w > 0)
+            break;
+        memmove(&nodes[i], &nodes[i + 1], (page->nodeCount - i - 1) * sizeof(fwtSkylineNode));
+        page->nodeCount--;
+        i--;
+    }
+    for (int i = 0; i + 1 < page->nodeCount; i++)
+        if (nodes[i].y == nodes[i + 1].y) {
+            nodes[i].w += nodes[i + 1].w;
+            memmove(&nodes[i + 1], &nodes[i + 2], (page->nodeCount - i - 2) * sizeof(fwtSkylineNode));
+            page->nodeCount--;
+            i--;
+        }
+    return true;
+}
+
+static fwtAtlasPage* NewAtlasPage(fwtState *state) {
+    state->atlasPages = realloc(state->atlasPages, (state->atlasPageCount + 1) * sizeof(fwtAtlasPage));
+    assert(state->atlasPages);
+    fwtAtlasPage *page = &state->atlasPages[state->atlasPageCount++];
+    memset(page, 0, sizeof(fwtAtlasPage));
+    // Pages are unnamed so fwtFindTexture never returns one
+    page->texture = NewTextureSlot(state, 0);
+    page->pixels = calloc(DEFAULT_ATLAS_PAGE_SIZE * DEFAULT_ATLAS_PAGE_SIZE, sizeof(int));
+    page->nodeCapacity = 16;
+    page->nodes = malloc(page->nodeCapacity * sizeof(fwtSkylineNode));
+    assert(page->pixels && page->nodes);
+    page->nodes[0] = (fwtSkylineNode) {.x = 0, .y = 0, .w = DEFAULT_ATLAS_PAGE_SIZE};
+    page->nodeCount = 1;
+    return page;
+}
+
+// Copies `image` into a shared atlas page and returns a handle to its region. Textures on the
+// same page batch together in sokol_gp, fwtDrawTexturedRect(s) remap `src_rect` into the page.
+// `image` can be freed once this returns, regions are only reclaimed along with their page.
+uint64_t fwtPackTexture(fwtState *state, const char *name, ezImage *image) {
+    int w = image->w + ATLAS_PADDING, h = image->h + ATLAS_PADDING;
+    if (w > DEFAULT_ATLAS_PAGE_SIZE || h > DEFAULT_ATLAS_PAGE_SIZE)
+        return fwtCreateTexture(state, name, image);
+
+    int x, y;
+    fwtAtlasPage *page = NULL;
+    for (int i = 0; i < state->atlasPageCount; i++)
+        if (SkylinePack(&state->atlasPages[i], w, h, &x, &y)) {
+            page = &state->atlasPages[i];
+            break;
+        }
+    if (!page) {
+        page = NewAtlasPage(state);
+        bool packed = SkylinePack(page, w, h, &x, &y);
+        assert(packed);
+    }
+    for (int row = 0; row < image->h; row++)
+        memcpy(page->pixels + (y + row) * DEFAULT_ATLAS_PAGE_SIZE + x,
+               image->buf + row * image->w,
+               image->w * sizeof(int));
+    page->dirty = true;
+
+    uint32_t pageTexture = page->texture;
+    uint32_t index = NewTextureSlot(state, MurmurHash((void*)name, strlen(name), 0));
+    state->textures[index] = (fwtTexture) {
+        .internal = {SG_INVALID_ID},
+        .w = image->w,
+        .h = image->h,
+        .page = pageTexture + 1,
+        .x = x,
+        .y = y
+    };
+    return TEXTURE_HANDLE(index, state->textureSlots[index].generation);
+}
+
+typedef struct {
+    uint32_t texture;
+} fwtDestroyTextureData;
+
+void fwtDestroyTexture(fwtState *state, uint64_t texture_id) {
+    if (!fwtIsTextureValid(state, texture_id))
+        return;
+    fwtDestroyTextureData data = {
+        .texture = TEXTURE_INDEX(texture_id)
+    };
+    PushCommand(state, fwtCommandDestroyTexture, &data, sizeof(data));
+    FreeTextureSlot(state, data.texture);
+}
+
+#if !defined(FWT_SCENE)
+static sg_image placeholderImage = {SG_INVALID_ID};
+
+#define COMMAND_PAYLOAD(TYPE, NAME, SRC) \
+    TYPE NAME;                           \
+    memcpy(&NAME, (SRC), sizeof(TYPE))
+
+#define COMMAND_ARRAY(PAYLOAD, SIZE) \
+    ((const unsigned char*)COMMAND_ARRAY_ALIGN_UP((uintptr_t)(PAYLOAD) + (SIZE)))
+
+static size_t ProcessProject(const unsigned char *payload) {
+    COMMAND_PAYLOAD(fwtProjectData, data, payload);
+    sgp_project(data.left, data.right, data.top, data.bottom);
+    return sizeof(fwtProjectData);
+}
+
+static size_t ProcessResetProject(const unsigned char *payload) {
+    sgp_reset_project();
+    return 0;
+}
+
+static size_t ProcessPushTransform(const unsigned char *payload) {
+    sgp_push_transform();
+    return 0;
+}
+
+static size_t ProcessPopTransform(const unsigned char *payload) {
+    sgp_pop_transform();
+    return 0;
+}
+
+static size_t ProcessResetTransform(const unsigned char *payload) {
+    sgp_reset_transform();
+    return 0;
+}
+
+static size_t ProcessTranslate(const unsigned char *payload) {
+    COMMAND_PAYLOAD(fwtTranslateData, data, payload);
+    sgp_translate(data.x, data.y);
+    return sizeof(fwtTranslateData);
+}
+
+static size_t ProcessRotate(const unsigned char *payload) {
+    COMMAND_PAYLOAD(fwtRotateData, data, payload);
+    sgp_rotate(data.theta);
+    return sizeof(fwtRotateData);
+}
+
+static size_t ProcessRotateAt(const unsigned char *payload) {
+    COMMAND_PAYLOAD(fwtRotateAtData, data, payload);
+    sgp_rotate_at(data.theta, data.x, data.y);
+    return sizeof(fwtRotateAtData);
+}
+
+static size_t ProcessScale(const unsigned char *payload) {
+    COMMAND_PAYLOAD(fwtScaleData, data, payload);
+    sgp_scale(data.sx, data.sy);
+    return sizeof(fwtScaleData);
+}
+
+static size_t ProcessScaleAt(const unsigned char *payload) {
+    COMMAND_PAYLOAD(fwtScaleAtData, data, payload);
+    sgp_scale_at(data.sx, data.sy, data.x, data.y);
+    return sizeof(fwtScaleAtData);
+}
+
+static size_t ProcessResetPipeline(const unsigned char *payload) {
+    sgp_reset_pipeline();
+    return 0;
+}
+
+static size_t ProcessSetUniform(const unsigned char *payload) {
+    COMMAND_PAYLOAD(fwtSetUniformData, data, payload);
+    const unsigned char *uniform = COMMAND_ARRAY(payload, sizeof(fwtSetUniformData));
+    sgp_set_uniform(uniform, data.size);
+    return (uniform - payload) + data.size;
+}
+
+static size_t ProcessResetUniform(const unsigned char *payload) {
+    sgp_reset_uniform();
+    return 0;
+}
+
+static size_t ProcessSetBlendMode(const unsigned char *payload) {
+    COMMAND_PAYLOAD(fwtSetBlendModeData, data, payload);
+    sgp_set_blend_mode(data.blend_mode);
+    return sizeof(fwtSetBlendModeData);
+}
+
+static size_t ProcessResetBlendMode(const unsigned char *payload) {
+    sgp_reset_blend_mode();
+    return 0;
+}
+
+static size_t ProcessSetColor(const unsigned char *payload) {
+    COMMAND_PAYLOAD(fwtSetColorData, data, payload);
+    sgp_set_color(data.r, data.g, data.b, data.a);
+    return sizeof(fwtSetColorData);
+}
+
+static size_t ProcessResetColor(const unsigned char *payload) {
+    sgp_reset_color();
+    return 0;
+}
+
+// Origin of the atlas region bound to each channel, added to textured rect sources
+static sgp_vec2 imageOffsets[SGP_TEXTURE_SLOTS];
+
+// Wherever sokol_gp's images are reset the offsets go with them
+static void ResetImageOffsets(void) {
+    memset(imageOffsets, 0, sizeof(imageOffsets));
+}
+
+static size_t ProcessSetImage(const unsigned char *payload) {
+    COMMAND_PAYLOAD(fwtSetImageData, data, payload);
+    fwtTexture *texture = &state.textures[data.texture];
+    sg_image image = texture->internal;
+    imageOffsets[data.channel] = (sgp_vec2) {0.f, 0.f};
+    if (texture->page) {
+        image = state.textures[texture->page - 1].internal;
+        imageOffsets[data.channel] = (sgp_vec2) {(float)texture->x, (float)texture->y};
     }
-    case fwtCommandDrawFilledRect: {
-        fwtDrawFilledRectData* data = (fwtDrawFilledRectData*)command->data;
-        sgp_draw_filled_rect(data->x, data->y, data->w, data->h);
-        break;
+    // Textures from fwtLoadTextureAsync have no image until their upload
+    sgp_set_image(data.channel, image.id != SG_INVALID_ID ? image : placeholderImage);
+    return sizeof(fwtSetImageData);
+}
+
+static size_t ProcessUnsetImage(const unsigned char *payload) {
+    COMMAND_PAYLOAD(fwtUnsetImageData, data, payload);
+    sgp_unset_image(data.channel);
+    imageOffsets[data.channel] = (sgp_vec2) {0.f, 0.f};
+    return sizeof(fwtUnsetImageData);
+}
+
+static size_t ProcessResetImage(const unsigned char *payload) {
+    COMMAND_PAYLOAD(fwtResetImageData, data, payload);
+    sgp_reset_image(data.channel);
+    imageOffsets[data.channel] = (sgp_vec2) {0.f, 0.f};
+    return sizeof(fwtResetImageData);
+}
+
+static size_t ProcessResetSampler(const unsigned char *payload) {
+    COMMAND_PAYLOAD(fwtResetSamplerData, data, payload);
+    sgp_reset_sampler(data.channel);
+    return sizeof(fwtResetSamplerData);
+}
+
+static size_t ProcessViewport(const unsigned char *payload) {
+    COMMAND_PAYLOAD(fwtViewportData, data, payload);
+    sgp_viewport(data.x, data.y, data.w, data.h);
+    return sizeof(fwtViewportData);
+}
+
+static size_t ProcessResetViewport(const unsigned char *payload) {
+    sgp_reset_viewport();
+    return 0;
+}
+
+static size_t ProcessScissor(const unsigned char *payload) {
+    COMMAND_PAYLOAD(fwtScissorData, data, payload);
+    sgp_scissor(data.x, data.y, data.w, data.h);
+    return sizeof(fwtScissorData);
+}
+
+static size_t ProcessResetScissor(const unsigned char *payload) {
+    sgp_reset_scissor();
+    return 0;
+}
+
+static size_t ProcessResetState(const unsigned char *payload) {
+    sgp_reset_state();
+    ResetImageOffsets();
+    return 0;
+}
+
+static size_t ProcessClear(const unsigned char *payload) {
+    sgp_clear();
+    return 0;
+}
+
+static size_t ProcessDrawPoints(const unsigned char *payload) {
+    COMMAND_PAYLOAD(fwtDrawPointsData, data, payload);
+    const unsigned char *points = COMMAND_ARRAY(payload, sizeof(fwtDrawPointsData));
+    sgp_draw_points((const sgp_point*)points, data.count);
+    return (points - payload) + data.count * sizeof(sgp_point);
+}
+
+static size_t ProcessDrawPoint(const unsigned char *payload) {
+    COMMAND_PAYLOAD(fwtDrawPointData, data, payload);
+    sgp_draw_point(data.x, data.y);
+    return sizeof(fwtDrawPointData);
+}
+
+static size_t ProcessDrawLines(const unsigned char *payload) {
+    COMMAND_PAYLOAD(fwtDrawLinesData, data, payload);
+    const unsigned char *lines = COMMAND_ARRAY(payload, sizeof(fwtDrawLinesData));
+    sgp_draw_lines((const sgp_line*)lines, data.count);
+    return (lines - payload) + data.count * sizeof(sgp_line);
+}
+
+static size_t ProcessDrawLine(const unsigned char *payload) {
+    COMMAND_PAYLOAD(fwtDrawLineData, data, payload);
+    sgp_draw_line(data.ax, data.ay, data.bx, data.by);
+    return sizeof(fwtDrawLineData);
+}
+
+static size_t ProcessDrawLinesStrip(const unsigned char *payload) {
+    COMMAND_PAYLOAD(fwtDrawLinesStripData, data, payload);
+    const unsigned char *points = COMMAND_ARRAY(payload, sizeof(fwtDrawLinesStripData));
+    sgp_draw_lines_strip((const sgp_point*)points, data.count);
+    return (points - payload) + data.count * sizeof(sgp_point);
+}
+
+static size_t ProcessDrawFilledTriangles(const unsigned char *payload) {
+    COMMAND_PAYLOAD(fwtDrawFilledTrianglesData, data, payload);
+    const unsigned char *triangles = COMMAND_ARRAY(payload, sizeof(fwtDrawFilledTrianglesData));
+    sgp_draw_filled_triangles((const sgp_triangle*)triangles, data.count);
+    return (triangles - payload) + data.count * sizeof(sgp_triangle);
+}
+
+static size_t ProcessDrawFilledTriangle(const unsigned char *payload) {
+    COMMAND_PAYLOAD(fwtDrawFilledTriangleData, data, payload);
+    sgp_draw_filled_triangle(data.ax, data.ay, data.bx, data.by, data.cx, data.cy);
+    return sizeof(fwtDrawFilledTriangleData);
+}
+
+static size_t ProcessDrawFilledTrianglesStrip(const unsigned char *payload) {
+    COMMAND_PAYLOAD(fwtDrawFilledTrianglesStripData, data, payload);
+    const unsigned char *points = COMMAND_ARRAY(payload, sizeof(fwtDrawFilledTrianglesStripData));
+    sgp_draw_filled_triangles_strip((const sgp_point*)points, data.count);
+    return (points - payload) + data.count * sizeof(sgp_point);
+}
+
+static size_t ProcessDrawFilledRects(const unsigned char *payload) {
+    COMMAND_PAYLOAD(fwtDrawFilledRectsData, data, payload);
+    const unsigned char *rects = COMMAND_ARRAY(payload, sizeof(fwtDrawFilledRectsData));
+    sgp_draw_filled_rects((const sgp_rect*)rects, data.count);
+    return (rects - payload) + data.count * sizeof(sgp_rect);
+}
+
+static size_t ProcessDrawFilledRect(const unsigned char *payload) {
+    COMMAND_PAYLOAD(fwtDrawFilledRectData, data, payload);
+    sgp_draw_filled_rect(data.x, data.y, data.w, data.h);
+    return sizeof(fwtDrawFilledRectData);
+}
+
+static size_t ProcessDrawTexturedRects(const unsigned char *payload) {
+    COMMAND_PAYLOAD(fwtDrawTexturedRectsData, data, payload);
+    const unsigned char *rects = COMMAND_ARRAY(payload, sizeof(fwtDrawTexturedRectsData));
+    sgp_vec2 offset = imageOffsets[data.channel];
+    if (offset.x == 0.f && offset.y == 0.f)
+        sgp_draw_textured_rects(data.channel, (const sgp_textured_rect*)rects, data.count);
+    else {
+        // The recorded array is shared with retained lists, remap a copy
+        static sgp_textured_rect *remapped = NULL;
+        static int remappedCapacity = 0;
+        if (data.count > remappedCapacity) {
+            remappedCapacity = data.count;
+            remapped = realloc(remapped, remappedCapacity * sizeof(sgp_textured_rect));
+            assert(remapped);
+        }
+        memcpy(remapped, rects, data.count * sizeof(sgp_textured_rect));
+        for (int i = 0; i < data.count; i++) {
+            remapped[i].src.x += offset.x;
+            remapped[i].src.y += offset.y;
+        }
+        sgp_draw_textured_rects(data.channel, remapped, data.count);
     }
-    case fwtCommandDrawTexturedRects: {
-        fwtDrawTexturedRectsData* data = (fwtDrawTexturedRectsData*)command->data;
-        sgp_draw_textured_rects(data->channel, data->rects, data->count);
-        break;
+    return (rects - payload) + data.count * sizeof(sgp_textured_rect);
+}
+
+static size_t ProcessDrawTexturedRect(const unsigned char *payload) {
+    COMMAND_PAYLOAD(fwtDrawTexturedRectData, data, payload);
+    data.src_rect.x += imageOffsets[data.channel].x;
+    data.src_rect.y += imageOffsets[data.channel].y;
+    sgp_draw_textured_rect(data.channel, data.dest_rect, data.src_rect);
+    return sizeof(fwtDrawTexturedRectData);
+}
+
+static size_t ProcessCreateTexture(const unsigned char *payload) {
+    COMMAND_PAYLOAD(fwtCreateTextureData, data, payload);
+    fwtTexture *texture = &state.textures[data.texture];
+    *texture = EmptyTexture(data.image->w, data.image->h);
+    UpdateTexture(texture, data.image->buf, data.image->w, data.image->h);
+    return sizeof(fwtCreateTextureData);
+}
+
+static size_t ProcessCreatePackedTexture(const unsigned char *payload) {
+    COMMAND_PAYLOAD(fwtCreatePackedTextureData, data, payload);
+    state.textures[data.texture] = PackedTexture(&state.texturePack, &state.texturePack.entries[data.entry]);
+    return sizeof(fwtCreatePackedTextureData);
+}
+
+static size_t ProcessDestroyTexture(const unsigned char *payload) {
+    COMMAND_PAYLOAD(fwtDestroyTextureData, data, payload);
+    DestroyTexture(&state.textures[data.texture]);
+    return sizeof(fwtDestroyTextureData);
+}
+
+typedef struct {
+    uint64_t key;
+    const unsigned char *records;
+    size_t size;
+} fwtSortItem;
+
+static fwtSortItem *sortItems = NULL, *sortScratch = NULL;
+// Sorted sections nest when a retained list with its own section is submitted inside
+// another, the inner one works on the items above `sortItemsTop`
+static size_t sortItemsCapacity = 0, sortItemsTop = 0;
+
+// Stable LSD radix sort on 8-bit digits, digits shared by every key are skipped
+static fwtSortItem* RadixSortItems(fwtSortItem *items, fwtSortItem *scratch, size_t count) {
+    for (int shift = 0; shift < 64; shift += 8) {
+        size_t offsets[257] = {0};
+        for (size_t i = 0; i < count; i++)
+            offsets[((items[i].key >> shift) & 0xFF) + 1]++;
+        if (offsets[((items[0].key >> shift) & 0xFF) + 1] == count)
+            continue;
+        for (int i = 1; i < 257; i++)
+            offsets[i] += offsets[i - 1];
+        for (size_t i = 0; i < count; i++)
+            scratch[offsets[(items[i].key >> shift) & 0xFF]++] = items[i];
+        fwtSortItem *tmp = items;
+        items = scratch;
+        scratch = tmp;
+    }
+    return items;
+}
+
+static uint32_t frameCommands = 0, frameDraws = 0;
+
+static size_t ProcessCommand(const unsigned char *record);
+
+static void ProcessCommandRange(const unsigned char *record, const unsigned char *end) {
+    while (record < end)
+        record += ProcessCommand(record);
+}
+
+static size_t ProcessBeginSort(const unsigned char *payload) {
+    COMMAND_PAYLOAD(fwtBeginSortData, data, payload);
+    const unsigned char *cursor = payload + sizeof(fwtBeginSortData);
+    const unsigned char *end = cursor + data.size;
+    size_t base = sortItemsTop, count = 0;
+    while (cursor < end) {
+        assert(cursor[0] == fwtCommandSortItem);
+        COMMAND_PAYLOAD(fwtSortItemData, item, cursor + 1);
+        if (base + count == sortItemsCapacity) {
+            sortItemsCapacity = sortItemsCapacity ? sortItemsCapacity * 2 : 256;
+            sortItems = realloc(sortItems, sortItemsCapacity * sizeof(fwtSortItem));
+            sortScratch = realloc(sortScratch, sortItemsCapacity * sizeof(fwtSortItem));
+            assert(sortItems && sortScratch);
+        }
+        cursor += 1 + sizeof(fwtSortItemData);
+        sortItems[base + count++] = (fwtSortItem) {
+            .key = item.key,
+            .records = cursor,
+            .size = item.size
+        };
+        cursor += item.size;
+    }
+    if (count) {
+        // A nested section can grow (and move) both buffers, so items are re-read by index
+        bool scratch = RadixSortItems(sortItems + base, sortScratch + base, count) != sortItems + base;
+        sortItemsTop = base + count;
+        for (size_t i = 0; i < count; i++) {
+            fwtSortItem sorted = (scratch ? sortScratch : sortItems)[base + i];
+            ProcessCommandRange(sorted.records, sorted.records + sorted.size);
+        }
+        sortItemsTop = base;
     }
-    case fwtCommandDrawTexturedRect: {
-        fwtDrawTexturedRectData* data = (fwtDrawTexturedRectData*)command->data;
-        sgp_draw_textured_rect(data->channel, data->dest_rect, data->src_rect);
-        break;
+    return sizeof(fwtBeginSortData) + data.size;
+}
+
+// Only reached if a sorted section is replayed linearly
+static size_t ProcessSortItem(const unsigned char *payload) {
+    return sizeof(fwtSortItemData);
+}
+
+// Only found in captures, `payload[0]` filler bytes that realign the next record
+static size_t ProcessPad(const unsigned char *payload) {
+    return 1 + payload[0];
+}
+
+typedef struct {
+    sgp_state before, after;
+    sgp_vec2 offsetsBefore[SGP_TEXTURE_SLOTS], offsetsAfter[SGP_TEXTURE_SLOTS]; // See imageOffsets
+    uint64_t textureEpoch;
+    uint32_t baseVertex, baseUniform;
+    uint32_t vertexCount, uniformCount, commandCount;
+    uint32_t recordCount, drawCount; // Stats the skipped ProcessCommand calls would have counted
+} fwtCommandListCache;
+
+#define LIST_CACHE_VERTICES(C) ((sgp_vertex*)((fwtCommandListCache*)(C) + 1))
+#define LIST_CACHE_UNIFORMS(C) ((sgp_uniform*)(LIST_CACHE_VERTICES(C) + (C)->vertexCount))
+#define LIST_CACHE_COMMANDS(C) ((_sgp_command*)(LIST_CACHE_UNIFORMS(C) + (C)->uniformCount))
+
+static bool SameGPState(const sgp_state *a, const sgp_state *b) {
+    sgp_state _a, _b;
+    memcpy(&_a, a, sizeof(sgp_state));
+    memcpy(&_b, b, sizeof(sgp_state));
+    _a._base_vertex = _b._base_vertex = 0;
+    _a._base_uniform = _b._base_uniform = 0;
+    _a._base_command = _b._base_command = 0;
+    return !memcmp(&_a, &_b, sizeof(sgp_state));
+}
+
+static bool ReplayCachedList(fwtCommandListCache *cache) {
+    if (cache->textureEpoch != textureEpoch ||
+        !SameGPState(&cache->before, &_sgp.state) ||
+        memcmp(cache->offsetsBefore, imageOffsets, sizeof(imageOffsets)) ||
+        _sgp.cur_vertex + cache->vertexCount > _sgp.num_vertices ||
+        _sgp.cur_uniform + cache->uniformCount > _sgp.num_uniforms ||
+        _sgp.cur_command + cache->commandCount > _sgp.num_commands)
+        return false;
+    memcpy(&_sgp.vertices[_sgp.cur_vertex], LIST_CACHE_VERTICES(cache), cache->vertexCount * sizeof(sgp_vertex));
+    memcpy(&_sgp.uniforms[_sgp.cur_uniform], LIST_CACHE_UNIFORMS(cache), cache->uniformCount * sizeof(sgp_uniform));
+    _sgp_command *commands = LIST_CACHE_COMMANDS(cache);
+    for (uint32_t i = 0; i < cache->commandCount; i++) {
+        _sgp_command command = commands[i];
+        if (command.cmd == SGP_COMMAND_DRAW) {
+            command.args.draw.vertex_index = command.args.draw.vertex_index - cache->baseVertex + _sgp.cur_vertex;
+            if (command.args.draw.uniform_index != _SGP_IMPOSSIBLE_ID)
+                command.args.draw.uniform_index = command.args.draw.uniform_index - cache->baseUniform + _sgp.cur_uniform;
+        }
+        _sgp.commands[_sgp.cur_command + i] = command;
+    }
+    _sgp.cur_vertex += cache->vertexCount;
+    _sgp.cur_uniform += cache->uniformCount;
+    _sgp.cur_command += cache->commandCount;
+    sgp_state current = _sgp.state;
+    _sgp.state = cache->after;
+    _sgp.state._base_vertex = current._base_vertex;
+    _sgp.state._base_uniform = current._base_uniform;
+    _sgp.state._base_command = current._base_command;
+    memcpy(imageOffsets, cache->offsetsAfter, sizeof(imageOffsets));
+    frameCommands += cache->recordCount;
+    frameDraws += cache->drawCount;
+    return true;
+}
+
+// While capturing, every record that reaches sokol_gp is appended in the order it was
+// replayed: thread buffers already merged, sorted items already sorted and lists inlined.
+// So the capture replays as one flat stream with no resources or pointers left in it
+static fwtCommandBuffer capture = {0};
+static bool capturing = false;
+
+static size_t ProcessSubmitList(const unsigned char *payload) {
+    COMMAND_PAYLOAD(fwtSubmitListData, data, payload);
+    fwtCommandList *list = data.list;
+    // Cached lists skip ProcessCommand, a capture needs the records
+    if (!capturing && list->cache && ReplayCachedList(list->cache))
+        return sizeof(fwtSubmitListData);
+
+    sgp_state before = _sgp.state;
+    sgp_vec2 offsets[SGP_TEXTURE_SLOTS];
+    memcpy(offsets, imageOffsets, sizeof(imageOffsets));
+    uint32_t vertex = _sgp.cur_vertex, uniform = _sgp.cur_uniform, command = _sgp.cur_command;
+    uint32_t transformDepth = _sgp.cur_transform, stateDepth = _sgp.cur_state;
+    // The batch optimizer may merge the list's first draws into earlier commands
+    uint32_t lookbackCount = command - _sgp.state._base_command;
+    if (lookbackCount > SGP_BATCH_OPTIMIZER_DEPTH)
+        lookbackCount = SGP_BATCH_OPTIMIZER_DEPTH;
+    _sgp_command lookback[SGP_BATCH_OPTIMIZER_DEPTH + 1];
+    memcpy(lookback, &_sgp.commands[command - lookbackCount], lookbackCount * sizeof(_sgp_command));
+    uint32_t records = frameCommands, draws = frameDraws;
+
+    ProcessCommandRange(list->buffer.data, list->buffer.data + list->buffer.size);
+
+    if (_sgp.last_error != SGP_NO_ERROR ||
+        _sgp.cur_vertex < vertex || _sgp.cur_uniform < uniform || _sgp.cur_command < command ||
+        transformDepth != _sgp.cur_transform || stateDepth != _sgp.cur_state ||
+        memcmp(lookback, &_sgp.commands[command - lookbackCount], lookbackCount * sizeof(_sgp_command)))
+        goto NO_CACHE;
+    for (uint32_t i = command; i < _sgp.cur_command; i++)
+        if (_sgp.commands[i].cmd == SGP_COMMAND_DRAW &&
+            (_sgp.commands[i].args.draw.vertex_index < vertex ||
+             (_sgp.commands[i].args.draw.uniform_index != _SGP_IMPOSSIBLE_ID && _sgp.commands[i].args.draw.uniform_index < uniform)))
+            goto NO_CACHE;
+
+    uint32_t vertexCount = _sgp.cur_vertex - vertex;
+    uint32_t uniformCount = _sgp.cur_uniform - uniform;
+    uint32_t commandCount = _sgp.cur_command - command;
+    size_t cacheSize = sizeof(fwtCommandListCache) +
+                       vertexCount * sizeof(sgp_vertex) +
+                       uniformCount * sizeof(sgp_uniform) +
+                       commandCount * sizeof(_sgp_command);
+    if (cacheSize > list->cacheCapacity) {
+        list->cache = realloc(list->cache, cacheSize);
+        assert(list->cache);
+        list->cacheCapacity = cacheSize;
+    }
+    fwtCommandListCache *cache = list->cache;
+    cache->before = before;
+    cache->after = _sgp.state;
+    memcpy(cache->offsetsBefore, offsets, sizeof(offsets));
+    memcpy(cache->offsetsAfter, imageOffsets, sizeof(imageOffsets));
+    cache->textureEpoch = textureEpoch;
+    cache->baseVertex = vertex;
+    cache->baseUniform = uniform;
+    cache->vertexCount = vertexCount;
+    cache->uniformCount = uniformCount;
+    cache->commandCount = commandCount;
+    cache->recordCount = frameCommands - records;
+    cache->drawCount = frameDraws - draws;
+    memcpy(LIST_CACHE_VERTICES(cache), &_sgp.vertices[vertex], vertexCount * sizeof(sgp_vertex));
+    memcpy(LIST_CACHE_UNIFORMS(cache), &_sgp.uniforms[uniform], uniformCount * sizeof(sgp_uniform));
+    memcpy(LIST_CACHE_COMMANDS(cache), &_sgp.commands[command], commandCount * sizeof(_sgp_command));
+    return sizeof(fwtSubmitListData);
+
+NO_CACHE:
+    // Keep the allocation, but make sure a stale cache is never hit
+    if (list->cache)
+        memset(&((fwtCommandListCache*)list->cache)->before, 0xFF, sizeof(sgp_state));
+    return sizeof(fwtSubmitListData);
+}
+
+// Each handler decodes its payload, issues it to sokol_gp and returns the payload size
+typedef size_t(*fwtCommandHandler)(const unsigned char*);
+
+static const fwtCommandHandler commandHandlers[fwtCommandCount] = {
+    [fwtCommandProject] = ProcessProject,
+    [fwtCommandResetProject] = ProcessResetProject,
+    [fwtCommandPushTransform] = ProcessPushTransform,
+    [fwtCommandPopTransform] = ProcessPopTransform,
+    [fwtCommandResetTransform] = ProcessResetTransform,
+    [fwtCommandTranslate] = ProcessTranslate,
+    [fwtCommandRotate] = ProcessRotate,
+    [fwtCommandRotateAt] = ProcessRotateAt,
+    [fwtCommandScale] = ProcessScale,
+    [fwtCommandScaleAt] = ProcessScaleAt,
+    [fwtCommandResetPipeline] = ProcessResetPipeline,
+    [fwtCommandSetUniform] = ProcessSetUniform,
+    [fwtCommandResetUniform] = ProcessResetUniform,
+    [fwtCommandSetBlendMode] = ProcessSetBlendMode,
+    [fwtCommandResetBlendMode] = ProcessResetBlendMode,
+    [fwtCommandSetColor] = ProcessSetColor,
+    [fwtCommandResetColor] = ProcessResetColor,
+    [fwtCommandSetImage] = ProcessSetImage,
+    [fwtCommandUnsetImage] = ProcessUnsetImage,
+    [fwtCommandResetImage] = ProcessResetImage,
+    [fwtCommandResetSampler] = ProcessResetSampler,
+    [fwtCommandViewport] = ProcessViewport,
+    [fwtCommandResetViewport] = ProcessResetViewport,
+    [fwtCommandScissor] = ProcessScissor,
+    [fwtCommandResetScissor] = ProcessResetScissor,
+    [fwtCommandResetState] = ProcessResetState,
+    [fwtCommandClear] = ProcessClear,
+    [fwtCommandDrawPoints] = ProcessDrawPoints,
+    [fwtCommandDrawPoint] = ProcessDrawPoint,
+    [fwtCommandDrawLines] = ProcessDrawLines,
+    [fwtCommandDrawLine] = ProcessDrawLine,
+    [fwtCommandDrawLinesStrip] = ProcessDrawLinesStrip,
+    [fwtCommandDrawFilledTriangles] = ProcessDrawFilledTriangles,
+    [fwtCommandDrawFilledTriangle] = ProcessDrawFilledTriangle,
+    [fwtCommandDrawFilledTrianglesStrip] = ProcessDrawFilledTrianglesStrip,
+    [fwtCommandDrawFilledRects] = ProcessDrawFilledRects,
+    [fwtCommandDrawFilledRect] = ProcessDrawFilledRect,
+    [fwtCommandDrawTexturedRects] = ProcessDrawTexturedRects,
+    [fwtCommandDrawTexturedRect] = ProcessDrawTexturedRect,
+    [fwtCommandCreateTexture] = ProcessCreateTexture,
+    [fwtCommandDestroyTexture] = ProcessDestroyTexture,
+    [fwtCommandBeginSort] = ProcessBeginSort,
+    [fwtCommandSortItem] = ProcessSortItem,
+    [fwtCommandSubmitList] = ProcessSubmitList,
+    [fwtCommandCreatePackedTexture] = ProcessCreatePackedTexture,
+    [fwtCommandPad] = ProcessPad,
+};
+
+static void CaptureCommand(const unsigned char *record, size_t size) {
+    switch (record[0]) {
+    case fwtCommandBeginSort:
+    case fwtCommandSortItem:
+    case fwtCommandSubmitList:
+    case fwtCommandCreateTexture:
+    case fwtCommandDestroyTexture:
+    case fwtCommandCreatePackedTexture:
+    case fwtCommandPad:
+        return;
     }
-    case fwtCommandCreateTexture: {
-        fwtCreateTextureData* data = (fwtCreateTextureData*)command->data;
-        uint64_t hash = MurmurHash((void*)data->name, strlen(data->name), 0);
-        imap_slot_t *slot = imap_assign(state.textureMap, hash);
-        assert(!slot);
-        fwtTexture* texture = EmptyTexture(data->image->w, data->image->h);
-        UpdateTexture(texture, data->image->buf, data->image->w, data->image->h);
-        imap_setval64(state.textureMap, slot, (uint64_t)texture);
-        break;
+    // Inline arrays are aligned from the record's address, keep the copy congruent with it
+    size_t misaligned = ((uintptr_t)record - capture.size) & (COMMAND_ARRAY_ALIGN - 1);
+    if (misaligned) {
+        unsigned char count = misaligned == 1 ? 3 : (unsigned char)misaligned - 2;
+        unsigned char *pad = ReserveCommand(&capture, 2 + count);
+        pad[0] = fwtCommandPad;
+        pad[1] = count;
+        memset(pad + 2, 0, count);
+    }
+    memcpy(ReserveCommand(&capture, size), record, size);
+}
+
+// Decodes a single record and returns its total size (opcode + payload)
+static size_t ProcessCommand(const unsigned char *record) {
+    unsigned char type = record[0];
+    assert(type < fwtCommandCount);
+    frameCommands++;
+    if (type >= fwtCommandClear && type <= fwtCommandDrawTexturedRect)
+        frameDraws++;
+    size_t size = 1 + commandHandlers[type](record + 1);
+    if (capturing)
+        CaptureCommand(record, size);
+    return size;
+}
+
+// Reads sokol_gp's queue before sgp_flush rewinds it, binds are counted the way flush applies them
+static void CollectFrameStats(void) {
+    fwtFrameStats *stats = &state.frameStats;
+    stats->commands = frameCommands;
+    stats->draws = frameDraws;
+    stats->sgpCommands = _sgp.cur_command;
+    stats->maxCommands = _sgp.num_commands;
+    stats->vertices = _sgp.cur_vertex;
+    stats->maxVertices = _sgp.num_vertices;
+    stats->uniforms = _sgp.cur_uniform;
+    stats->maxUniforms = _sgp.num_uniforms;
+    frameCommands = frameDraws = 0;
+
+    uint32_t drawCalls = 0, binds = 0;
+    uint32_t images[SGP_TEXTURE_SLOTS];
+    for (int i = 0; i < SGP_TEXTURE_SLOTS; i++)
+        images[i] = _SGP_IMPOSSIBLE_ID;
+    for (uint32_t i = 0; i < _sgp.cur_command; i++) {
+        _sgp_draw_args *draw = &_sgp.commands[i].args.draw;
+        if (_sgp.commands[i].cmd != SGP_COMMAND_DRAW || !draw->num_vertices)
+            continue;
+        drawCalls++;
+        bool rebind = false;
+        for (uint32_t j = 0; j < SGP_TEXTURE_SLOTS; j++) {
+            uint32_t image = j < draw->textures.count ? draw->textures.images[j].id : SG_INVALID_ID;
+            if (images[j] != image) {
+                images[j] = image;
+                rebind = true;
+            }
+        }
+        if (rebind)
+            binds++;
     }
-    default:
-        abort();
+    stats->drawCalls = drawCalls;
+    stats->mergedBatches = stats->draws > drawCalls ? stats->draws - drawCalls : 0;
+    stats->textureBinds = binds;
+}
+
+static void BeginCapture(void) {
+    if (!state.capturePath[0])
+        return;
+    capture.size = 0;
+    capturing = true;
+}
+
+static void EndCapture(void) {
+    if (!capturing)
+        return;
+    capturing = false;
+    FILE *fh = fopen(state.capturePath, "wb");
+    if (!fh) {
+        fprintf(stderr, "[CAPTURE ERROR] Failed to open \"%s\"\n", state.capturePath);
+        goto BAIL;
     }
+    fwtCaptureHeader header = {
+        .magic = COMMAND_CAPTURE_MAGIC,
+        .version = COMMAND_CAPTURE_VERSION,
+        .textureCount = state.textureCount,
+        .width = state.windowWidth,
+        .height = state.windowHeight,
+        .size = capture.size
+    };
+    fwrite(&header, sizeof(header), 1, fh);
+    for (uint32_t i = 0; i < state.textureCount; i++) {
+        fwtTexture *texture = &state.textures[i];
+        // Atlas pages have no name, only an image
+        bool used = state.textureSlots[i].name || texture->internal.id != SG_INVALID_ID;
+        fwtCaptureTexture entry = {
+            .w = used ? texture->w : 0,
+            .h = used ? texture->h : 0,
+            .page = texture->page,
+            .x = texture->x,
+            .y = texture->y
+        };
+        fwrite(&entry, sizeof(entry), 1, fh);
+    }
+    static const unsigned char zeroes[16] = {0};
+    size_t offset = sizeof(header) + state.textureCount * sizeof(fwtCaptureTexture);
+    fwrite(zeroes, 1, (16 - offset % 16) % 16, fh);
+    fwrite(capture.data, 1, capture.size, fh);
+    fclose(fh);
+BAIL:
+    state.capturePath[0] = '\0';
 }
 #endif
 
+#if defined(FWT_MAC)
+#define DYLIB_EXT ".dylib"
+#elif defined(FWT_WINDOWS)
+#define DYLIB_EXT ".dll"
+#elif defined(FWT_LINUX)
+#define DYLIB_EXT ".so"
+#else
+#error Unsupported operating system
+#endif
+
 #if defined(FWT_WINDOWS)
 static FILETIME Win32GetLastWriteTime(char* path) {
     FILETIME time;
@@ -1177,228 +2086,1327 @@ static FILETIME Win32GetLastWriteTime(char* path) {
 #endif
 
 #if !defined(FWT_SCENE)
-static bool ReloadLibrary(const char *path) {
-#if defined(FWT_DISABLE_HOTRELOAD)
-    return true;
+typedef struct fwtLibrary fwtLibrary;
+struct fwtLibrary {
+    fwtLibrary *next;
+    char path[MAX_PATH];
+    char copy[MAX_PATH];
+    bool force; // Load even if the file hasn't changed
+    void *handle;
+    fwtScene *scene;
+#if defined(FWT_WINDOWS)
+    FILETIME writeTime;
+#else
+    ino_t id;
 #endif
+};
 
+static unsigned int libraryCopies = 0;
+
+static bool CopyLibrary(const char *from, const char *to) {
 #if defined(FWT_WINDOWS)
-    FILETIME newTime = Win32GetLastWriteTime(path);
-    bool result = CompareFileTime(&newTime, &state.libraryWriteTime);
-    if (result)
-        state.libraryWriteTime = newTime;
-    else
-        return true;
+    return CopyFile(from, to, 0);
+#else
+    FILE *in = fopen(from, "rb"), *out = in ? fopen(to, "wb") : NULL;
+    bool result = in && out;
+    char buffer[65536];
+    size_t bytes;
+    while (result && (bytes = fread(buffer, 1, sizeof(buffer), in)))
+        result = fwrite(buffer, 1, bytes, out) == bytes;
+    if (in)
+        fclose(in);
+    if (out)
+        fclose(out);
+    return result;
+#endif
+}
+
+// Everything that can stall (stat, copy, dlopen and symbol resolution) without touching any
+// resident scene, so it's safe to call from a loader thread. Returns false if unchanged.
+static bool OpenLibrary(fwtLibrary *library) {
+    FWT_PROFILE_SCOPE("OpenLibrary");
+    __atomic_fetch_add(&state.libraryChecks, 1, __ATOMIC_RELAXED);
+#if defined(FWT_WINDOWS)
+    FILETIME writeTime = Win32GetLastWriteTime(library->path);
+    if (!library->force && !CompareFileTime(&writeTime, &library->writeTime))
+        return false;
+    library->writeTime = writeTime;
 #else
     struct stat attr;
-    bool result = !stat(path, &attr) && state.libraryHandleID != attr.st_ino;
-    if (result)
-        state.libraryHandleID = attr.st_ino;
-    else
-        return true;
+    if (stat(library->path, &attr))
+        return false;
+    if (!library->force && attr.st_ino == library->id)
+        return false;
+    library->id = attr.st_ino;
+#endif
+
+    // dlopen returns the already loaded library for a path it has seen, and the old copy
+    // stays loaded until it's swapped out, so every load goes through a fresh copy
+    snprintf(library->copy, MAX_PATH, "%s.tmp.%u%s", library->path,
+             __atomic_fetch_add(&libraryCopies, 1, __ATOMIC_RELAXED), DYLIB_EXT);
+    if (!CopyLibrary(library->path, library->copy))
+        return false;
+    library->handle = dlopen(library->copy, RTLD_NOW);
+#if !defined(FWT_WINDOWS)
+    unlink(library->copy);
+#endif
+    if (!library->handle) {
+        fprintf(stderr, "[SCENE ERROR] %s\n", dlerror());
+        return false;
+    }
+    if (!(library->scene = dlsym(library->handle, "scene"))) {
+        fprintf(stderr, "[SCENE ERROR] No scene in \"%s\"\n", library->path);
+        dlclose(library->handle);
+        library->handle = NULL;
+        return false;
+    }
+#if !defined(FWT_RELEASE)
+    // The scene has its own copy of fwt.c, point its scopes at the program's profiler
+    fwtProfiler **sceneProfiler = dlsym(library->handle, "fwtActiveProfiler");
+    if (sceneProfiler)
+        *sceneProfiler = fwtActiveProfiler;
+#endif
+    return true;
+}
+
+static void CloseLibrary(fwtLibrary *library) {
+    if (!library->handle)
+        return;
+    dlclose(library->handle);
+    library->handle = NULL;
+#if defined(FWT_WINDOWS)
+    DeleteFileA(library->copy);
 #endif
+}
 
-    size_t libraryPathLength = state.libraryPath ? strlen(state.libraryPath) : 0;
+typedef struct {
+    char name[MAX_PATH];
+    void *data;
+    size_t size;
+} fwtSceneCacheEntry;
+
+// Serialized contexts of scenes that were evicted, keyed by scene name
+static fwtSceneCacheEntry *sceneCache = NULL;
+static int sceneCacheCount = 0;
+
+static void SceneName(const char *path, char *name) {
+    const char *base = strrchr(path, '/');
+    snprintf(name, MAX_PATH, "%s", base ? base + 1 : path);
+    size_t length = strlen(name), extLength = strlen(DYLIB_EXT);
+    if (length > extLength && !strcmp(name + length - extLength, DYLIB_EXT))
+        name[length - extLength] = '\0';
+}
+
+static int FindCachedScene(const char *name) {
+    for (int i = 0; i < sceneCacheCount; i++)
+        if (!strcmp(sceneCache[i].name, name))
+            return i;
+    return -1;
+}
+
+static void CacheSceneContext(const char *name, fwtScene *scene, fwtContext *context) {
+    size_t size = 0;
+    void *data = scene->serialize(&state, context, &size);
+    if (!data)
+        return;
+    int index = FindCachedScene(name);
+    if (index == -1) {
+        sceneCache = realloc(sceneCache, (sceneCacheCount + 1) * sizeof(fwtSceneCacheEntry));
+        assert(sceneCache);
+        index = sceneCacheCount++;
+        memcpy(sceneCache[index].name, name, MAX_PATH);
+    } else
+        free(sceneCache[index].data);
+    sceneCache[index].data = data;
+    sceneCache[index].size = size;
+}
+
+static fwtContext* RestoreSceneContext(const char *name, fwtScene *scene) {
+    int index = FindCachedScene(name);
+    if (index == -1)
+        return NULL;
+    fwtContext *result = scene->deserialize(&state, sceneCache[index].data, sceneCache[index].size);
+    // The live context is the source of truth again until the scene is evicted
+    free(sceneCache[index].data);
+    sceneCache[index] = sceneCache[--sceneCacheCount];
+    return result;
+}
+
+static void FreeSceneCache(void) {
+    for (int i = 0; i < sceneCacheCount; i++)
+        free(sceneCache[i].data);
+    free(sceneCache);
+    sceneCache = NULL;
+    sceneCacheCount = 0;
+}
 
-    if (state.libraryHandle) {
-        if (libraryPathLength != strlen(path) ||
-            strncmp(state.libraryPath, path, libraryPathLength)) {
-            if (state.libraryScene->deinit)
-                state.libraryScene->deinit(&state, state.libraryContext);
+typedef struct {
+    fwtLibrary library;
+    char name[MAX_PATH];
+    fwtContext *context;
+    bool attached; // Ticks alongside the primary scene
+    int order;
+    uint64_t lastUsed;
+} fwtResidentScene;
+
+// Scenes stay loaded and initialised after being swapped out, up to MAX_RESIDENT_SCENES.
+// The primary scene is mirrored in `state.library*`.
+static fwtResidentScene residentScenes[MAX_RESIDENT_SCENES];
+static int residentSceneCount = 0;
+static int primaryScene = -1;
+
+static int FindResidentScene(const char *path) {
+    for (int i = 0; i < residentSceneCount; i++)
+        if (!strcmp(residentScenes[i].library.path, path))
+            return i;
+    return -1;
+}
+
+static void SyncPrimaryScene(void) {
+    if (primaryScene == -1) {
+        state.libraryHandle = NULL;
+        state.libraryScene = NULL;
+        state.libraryContext = NULL;
+        state.libraryPath = NULL;
+        return;
+    }
+    fwtResidentScene *scene = &residentScenes[primaryScene];
+    scene->lastUsed = stm_now();
+    state.libraryHandle = scene->library.handle;
+    state.libraryScene = scene->library.scene;
+    state.libraryContext = scene->context;
+    state.libraryPath = scene->library.path;
+#if defined(FWT_WINDOWS)
+    state.libraryWriteTime = scene->library.writeTime;
+#else
+    state.libraryHandleID = scene->library.id;
+#endif
+}
+
+static void EvictResidentScene(int index) {
+    fwtResidentScene *scene = &residentScenes[index];
+    if (scene->library.scene->serialize)
+        CacheSceneContext(scene->name, scene->library.scene, scene->context);
+    if (scene->library.scene->deinit)
+        scene->library.scene->deinit(&state, scene->context);
+    CloseLibrary(&scene->library);
+    residentScenes[index] = residentScenes[--residentSceneCount];
+    if (primaryScene == index)
+        primaryScene = -1;
+    else if (primaryScene == residentSceneCount)
+        primaryScene = index;
+}
+
+// Takes ownership of the opened library, evicting the least recently used scene that
+// isn't ticking if every slot is taken
+static bool AddResidentScene(fwtLibrary *library, bool primary, bool attached, int order) {
+    if (residentSceneCount == MAX_RESIDENT_SCENES) {
+        int victim = -1;
+        for (int i = 0; i < residentSceneCount; i++) {
+            fwtResidentScene *scene = &residentScenes[i];
+            if (scene->attached || (i == primaryScene && !primary))
+                continue;
+            if (victim == -1 || scene->lastUsed < residentScenes[victim].lastUsed)
+                victim = i;
+        }
+        if (victim == -1) {
+            fprintf(stderr, "[SCENE ERROR] No room for \"%s\", raise MAX_RESIDENT_SCENES\n", library->path);
+            CloseLibrary(library);
+            return false;
+        }
+        EvictResidentScene(victim);
+    }
+
+    fwtResidentScene *scene = &residentScenes[residentSceneCount];
+    memset(scene, 0, sizeof(fwtResidentScene));
+    scene->library = *library;
+    SceneName(library->path, scene->name);
+    if (library->scene->deserialize)
+        scene->context = RestoreSceneContext(scene->name, library->scene);
+    if (!scene->context && !(scene->context = library->scene->init(&state))) {
+        fprintf(stderr, "[SCENE ERROR] \"%s\" failed to initialise\n", scene->name);
+        CloseLibrary(&scene->library);
+        return false;
+    }
+    scene->attached = attached;
+    scene->order = order;
+    scene->lastUsed = stm_now();
+    if (primary)
+        primaryScene = residentSceneCount;
+    residentSceneCount++;
+    SyncPrimaryScene();
+    return true;
+}
+
+// Hot reload, the context carries over to the new code
+static void ReplaceResidentScene(int index, fwtLibrary *library) {
+    fwtResidentScene *scene = &residentScenes[index];
+    if (scene->library.scene->unload)
+        scene->library.scene->unload(&state, scene->context);
+    CloseLibrary(&scene->library);
+    scene->library = *library;
+    if (scene->library.scene->reload)
+        scene->library.scene->reload(&state, scene->context);
+    SyncPrimaryScene();
+}
+
+// The primary scene and every attached scene, ordered by `order` (stable)
+static int TickingScenes(fwtResidentScene **scenes) {
+    int count = 0;
+    for (int i = 0; i < residentSceneCount; i++) {
+        fwtResidentScene *scene = &residentScenes[i];
+        if (i != primaryScene && !scene->attached)
+            continue;
+        int j = count++;
+        for (; j > 0 && scenes[j - 1]->order > scene->order; j--)
+            scenes[j] = scenes[j - 1];
+        scenes[j] = scene;
+    }
+    return count;
+}
+
+static bool ReloadLibrary(const char *path) {
+    FWT_PROFILE_SCOPE("ReloadLibrary");
+    fwtLibrary library = {.force = true};
+    snprintf(library.path, MAX_PATH, "%s", path);
+    return OpenLibrary(&library) && AddResidentScene(&library, true, false, 0);
+}
+
+typedef struct {
+    char path[MAX_PATH];
+    bool primary, attached;
+    int order;
+} fwtSceneLoad;
+
+// Libraries being opened on loader threads, what to do with them is decided on arrival
+// so requests made in the meantime still apply
+static fwtSceneLoad sceneLoads[MAX_SCENE_REQUESTS];
+static int sceneLoadCount = 0;
+static fwtLibrary *loadedLibraries = NULL; // Lock-free, pushed by the loader threads
+
+static int FindSceneLoad(const char *path) {
+    for (int i = 0; i < sceneLoadCount; i++)
+        if (!strcmp(sceneLoads[i].path, path))
+            return i;
+    return -1;
+}
+
+static void* LoadLibraryThread(void *arg) {
+    fwtLibrary *library = arg;
+    if (!OpenLibrary(library))
+        library->handle = NULL;
+    library->next = __atomic_load_n(&loadedLibraries, __ATOMIC_RELAXED);
+    while (!__atomic_compare_exchange_n(&loadedLibraries, &library->next, library, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+    return NULL;
+}
+
+static fwtSceneLoad* StartSceneLoad(const char *path, fwtLibrary *previous) {
+    if (sceneLoadCount == MAX_SCENE_REQUESTS) {
+        fprintf(stderr, "[SCENE ERROR] Too many scenes loading, dropped \"%s\"\n", path);
+        return NULL;
+    }
+    fwtSceneLoad *load = &sceneLoads[sceneLoadCount++];
+    memset(load, 0, sizeof(fwtSceneLoad));
+    snprintf(load->path, MAX_PATH, "%s", path);
+
+    fwtLibrary *library = calloc(1, sizeof(fwtLibrary));
+    assert(library);
+    if (previous)
+        *library = *previous;
+    else
+        library->force = true;
+    library->handle = NULL;
+    snprintf(library->path, MAX_PATH, "%s", path);
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, LoadLibraryThread, library))
+        LoadLibraryThread(library);
+    else
+        pthread_detach(thread);
+    return load;
+}
+
+// Swaps finished loads in between frames
+static void ProcessLoadedScenes(void) {
+    fwtLibrary *library = __atomic_exchange_n(&loadedLibraries, NULL, __ATOMIC_ACQUIRE);
+    while (library) {
+        fwtLibrary *next = library->next;
+        int index = FindSceneLoad(library->path);
+        if (index == -1) {
+            // Every library on the list was started by StartSceneLoad, this shouldn't happen
+            fprintf(stderr, "[SCENE ERROR] \"%s\" finished loading but was never requested\n", library->path);
+            CloseLibrary(library);
+            free(library);
+            library = next;
+            continue;
+        }
+        fwtSceneLoad load = sceneLoads[index];
+        sceneLoads[index] = sceneLoads[--sceneLoadCount];
+
+        if (library->handle) {
+            int resident = FindResidentScene(library->path);
+            if (resident != -1) {
+                ReplaceResidentScene(resident, library);
+                if (load.primary) {
+                    primaryScene = resident;
+                    SyncPrimaryScene();
+                }
+            } else
+                AddResidentScene(library, load.primary, load.attached, load.order);
+        } else if (load.primary || load.attached)
+            fprintf(stderr, "[SCENE ERROR] Failed to load \"%s\"\n", library->path);
+        free(library);
+        library = next;
+    }
+}
+
+static void ScenePath(const char *name, char *path) {
+    if (FileExt(name))
+        snprintf(path, MAX_PATH, "%s", name);
+    else
+        snprintf(path, MAX_PATH, "./%s/%s%s", FWT_DYLIB_PATH, name, DYLIB_EXT);
+}
+
+// Requests are recorded by the scenes during the frame and applied here, before any library
+// is closed, so names pointing into a scene library are still valid
+static void ProcessSceneRequests(void) {
+    char path[MAX_PATH];
+    if (state.nextScene) {
+        snprintf(path, MAX_PATH, "%s", state.nextScene);
+        state.nextScene = NULL;
+        int index = FindResidentScene(path);
+        if (index != -1) {
+            // Already resident, swapping is only a pointer flip
+            primaryScene = index;
+            SyncPrimaryScene();
         } else {
-            if (state.libraryScene->unload)
-                state.libraryScene->unload(&state, state.libraryContext);
+            index = FindSceneLoad(path);
+            fwtSceneLoad *load = index != -1 ? &sceneLoads[index] : StartSceneLoad(path, NULL);
+            if (load)
+                load->primary = true;
         }
-        dlclose(state.libraryHandle);
     }
 
+    for (int i = 0; i < state.sceneRequestCount; i++) {
+        fwtSceneRequest *request = &state.sceneRequests[i];
+        ScenePath(request->name, path);
+        int resident = FindResidentScene(path), loading = FindSceneLoad(path);
+        fwtSceneLoad *load = loading != -1 ? &sceneLoads[loading] : NULL;
+        switch (request->type) {
+            case fwtScenePreload:
+                if (resident == -1 && !load)
+                    StartSceneLoad(path, NULL);
+                break;
+            case fwtSceneAttach:
+                if (resident != -1) {
+                    residentScenes[resident].attached = true;
+                    residentScenes[resident].order = request->order;
+                    break;
+                }
+                if (!load && !(load = StartSceneLoad(path, NULL)))
+                    break;
+                load->attached = true;
+                load->order = request->order;
+                break;
+            case fwtSceneDetach:
+                if (resident != -1)
+                    residentScenes[resident].attached = false;
+                if (load)
+                    load->attached = false;
+                break;
+        }
+    }
+    state.sceneRequestCount = 0;
+}
+
+static void WaitForSceneLoads(void) {
+    while (sceneLoadCount) {
+        fwtLibrary *library = __atomic_exchange_n(&loadedLibraries, NULL, __ATOMIC_ACQUIRE);
+        while (library) {
+            fwtLibrary *next = library->next;
+            int index = FindSceneLoad(library->path);
+            if (index != -1)
+                sceneLoads[index] = sceneLoads[--sceneLoadCount];
+            CloseLibrary(library);
+            free(library);
+            library = next;
+        }
+        sched_yield();
+    }
+}
+
+#if !defined(FWT_DISABLE_HOTRELOAD)
+typedef struct {
+    char name[MAX_PATH];
+    uint64_t time;
+} fwtFileChange;
+
+// Filled by the dmon thread, drained on the main thread once a file stops changing
+typedef struct {
+    pthread_mutex_t lock;
+    fwtFileChange *changes;
+    int count, capacity;
+} fwtFileChanges;
+
+static void RecordFileChange(fwtFileChanges *list, const char *filepath) {
+    char name[MAX_PATH];
+    snprintf(name, MAX_PATH, "%s", filepath);
+    for (char *c = name; *c; c++)
+        if (*c == '\\')
+            *c = '/';
+
+    pthread_mutex_lock(&list->lock);
+    int i = 0;
+    for (; i < list->count; i++)
+        if (!strcmp(list->changes[i].name, name))
+            break;
+    if (i == list->count) {
+        if (list->count == list->capacity) {
+            list->capacity = list->capacity ? list->capacity * 2 : 16;
+            list->changes = realloc(list->changes, list->capacity * sizeof(fwtFileChange));
+            assert(list->changes);
+        }
+        memcpy(list->changes[list->count++].name, name, MAX_PATH);
+    }
+    // Every event pushes the change back, so a burst of writes is only handled once
+    list->changes[i].time = stm_now();
+    pthread_mutex_unlock(&list->lock);
+}
+
+static bool TakeFileChange(fwtFileChanges *list, char *name) {
+    bool result = false;
+    pthread_mutex_lock(&list->lock);
+    for (int i = 0; i < list->count; i++)
+        if (stm_ms(stm_since(list->changes[i].time)) >= DEFAULT_ASSET_RELOAD_DELAY_MS) {
+            memcpy(name, list->changes[i].name, MAX_PATH);
+            list->changes[i] = list->changes[--list->count];
+            result = true;
+            break;
+        }
+    pthread_mutex_unlock(&list->lock);
+    return result;
+}
+
+// Runs on the dmon thread, the frame loop only looks at the flag it leaves behind
+static void LibraryWatchCallback(dmon_watch_id watch_id,
+                                 dmon_action action,
+                                 const char* rootdir,
+                                 const char* filepath,
+                                 const char* oldfilepath,
+                                 void* user) {
+    if (action == DMON_ACTION_DELETE)
+        return;
+    size_t length = strlen(filepath), extLength = strlen(DYLIB_EXT);
+    // Libraries are loaded from .tmp. copies, don't let those retrigger a reload
+    if (length < extLength ||
+        strcmp(filepath + length - extLength, DYLIB_EXT) ||
+        strstr(filepath, ".tmp."))
+        return;
+    __atomic_store_n(&state.libraryChangeTime, stm_now(), __ATOMIC_RELEASE);
+}
+
+// Linkers write the library in several steps, wait for it to settle before opening it
+static bool LibraryChanged(void) {
+    uint64_t changed = __atomic_load_n(&state.libraryChangeTime, __ATOMIC_ACQUIRE);
+    if (!changed || stm_ms(stm_since(changed)) < DEFAULT_ASSET_RELOAD_DELAY_MS)
+        return false;
+    return __atomic_compare_exchange_n(&state.libraryChangeTime, &changed, 0, false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED);
+}
+
+// Every resident library is checked, OpenLibrary skips the ones that haven't changed
+static void ReloadResidentScenes(void) {
+    for (int i = 0; i < residentSceneCount; i++)
+        if (FindSceneLoad(residentScenes[i].library.path) == -1) {
+            fwtLibrary previous = residentScenes[i].library;
+            previous.force = false;
+            StartSceneLoad(previous.path, &previous);
+        }
+}
+
+#if defined(FWT_REBUILD_SCENES)
+static fwtFileChanges sceneChanges = {.lock = PTHREAD_MUTEX_INITIALIZER};
+
+static void SceneWatchCallback(dmon_watch_id watch_id,
+                               dmon_action action,
+                               const char* rootdir,
+                               const char* filepath,
+                               const char* oldfilepath,
+                               void* user) {
+    size_t length = strlen(filepath);
+    if (action != DMON_ACTION_DELETE && length > 2 && !strcmp(filepath + length - 2, ".c"))
+        RecordFileChange(&sceneChanges, filepath);
+}
+
+static void* RebuildSceneThread(void *arg) {
+    char *command = arg;
+    if (system(command))
+        fprintf(stderr, "[SCENE ERROR] \"%s\" failed\n", command);
+    free(command);
+    return NULL;
+}
+
+// Rebuilds only the changed scene through the Makefile's per-scene rule, the new library
+// is then picked up by LibraryWatchCallback like any other build
+static void RebuildChangedScenes(void) {
+    char name[MAX_PATH];
+    while (TakeFileChange(&sceneChanges, name)) {
+        name[strlen(name) - 2] = '\0';
+        char *command = malloc(MAX_PATH * 2);
+        assert(command);
+        snprintf(command, MAX_PATH * 2, "make %s/%s%s", FWT_DYLIB_PATH, name, DYLIB_EXT);
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, RebuildSceneThread, command))
+            free(command);
+        else
+            pthread_detach(thread);
+    }
+}
+#endif
+#endif
+
+static void Usage(const char *name) {
+    printf("  usage: %s [options]\n\n  options:\n", name);
+    printf("\t  help (flag) -- Show this message\n");
+    printf("\t  config (string) -- Path to .json config file\n");
+#define X(NAME, TYPE, VAL, DEFAULT, DOCS) \
+    printf("\t  %s (%s) -- %s (default: %d)\n", NAME, #TYPE, DOCS, DEFAULT);
+    SETTINGS
+#undef X
+}
+
+static int LoadConfig(const char *path) {
+    const char *data = NULL;
+    if (!(data = LoadFile(path, NULL)))
+        return 0;
+
+    const struct json_attr_t config_attr[] = {
+#define X(NAME, TYPE, VAL, DEFAULT,DOCS) \
+        {(char*)#NAME, t_##TYPE, .addr.TYPE=&state.desc.VAL},
+        SETTINGS
+#undef X
+        {NULL}
+    };
+    int status = json_read_object(data, config_attr, NULL);
+    if (!status)
+        return 0;
+    free((void*)data);
+    return 1;
+}
+
+#define jim_boolean jim_bool
+
+static int ExportConfig(const char *path) {
+    FILE *fh = fopen(path, "w");
+    if (!fh)
+        return 0;
+    Jim jim = {
+        .sink = fh,
+        .write = (Jim_Write)fwrite
+    };
+    jim_object_begin(&jim);
+#define X(NAME, TYPE, VAL, DEFAULT, DOCS) \
+    jim_member_key(&jim, NAME);           \
+    jim_##TYPE(&jim, state.desc.VAL);
+    SETTINGS
+#undef X
+    jim_object_end(&jim);
+    fclose(fh);
+    return 1;
+}
+
+static int ParseArguments(int argc, char *argv[]) {
+    const char *name = argv[0];
+    // sokol_args skips argv[0] itself, fwtArgument reads from this same setup
+    sargs_desc desc = (sargs_desc) {
+        .argc = argc,
+        .argv = (char**)argv
+    };
+    sargs_setup(&desc);
+
+#if !defined(FWT_EMSCRIPTEN)
+    if (sargs_exists("help")) {
+        Usage(name);
+        return 0;
+    }
+    if (sargs_exists("config")) {
+        const char *path = sargs_value("config");
+        if (!path) {
+            fprintf(stderr, "[ARGUMENT ERROR] No value passed for \"config\"\n");
+            Usage(name);
+            return 0;
+        }
+        if (!DoesFileExist(path)) {
+            fprintf(stderr, "[FILE ERROR] No file exists at \"%s\"\n", path);
+            Usage(name);
+            return 0;
+        }
+        LoadConfig(path);
+    }
+#endif // FWT_EMSCRIPTEN
+
+#define boolean 1
+#define integer 0
+#define X(NAME, TYPE, VAL, DEFAULT, DOCS)                                               \
+    if (sargs_exists(NAME))                                                             \
+    {                                                                                   \
+        const char *tmp = sargs_value_def(NAME, #DEFAULT);                              \
+        if (!tmp)                                                                       \
+        {                                                                               \
+            fprintf(stderr, "[ARGUMENT ERROR] No value passed for \"%s\"\n", NAME);     \
+            Usage(name);                                                                \
+            return 0;                                                                   \
+        }                                                                               \
+        if (TYPE == 1)                                                                  \
+            state.desc.VAL = (int)atoi(tmp);                                            \
+        else                                                                            \
+            state.desc.VAL = sargs_boolean(NAME);                                       \
+    }
+    SETTINGS
+#undef X
+#undef boolean
+#undef integer
+    return 1;
+}
+
+static void ProcessCommandBuffer(fwtCommandBuffer *buffer) {
+    while (buffer->cursor < buffer->size)
+        buffer->cursor += ProcessCommand(buffer->data + buffer->cursor);
+}
+
+static uint64_t atlasFrame = 1;
+
+// sokol only allows one update per image per frame, pages dirtied again wait for the next one
+static void UploadAtlasPages(void) {
+    for (int i = 0; i < state.atlasPageCount; i++) {
+        fwtAtlasPage *page = &state.atlasPages[i];
+        if (!page->dirty || page->uploadFrame == atlasFrame)
+            continue;
+        fwtTexture *texture = &state.textures[page->texture];
+        if (texture->internal.id == SG_INVALID_ID)
+            *texture = EmptyTexture(DEFAULT_ATLAS_PAGE_SIZE, DEFAULT_ATLAS_PAGE_SIZE);
+        UpdateTexture(texture, page->pixels, DEFAULT_ATLAS_PAGE_SIZE, DEFAULT_ATLAS_PAGE_SIZE);
+        page->dirty = false;
+        page->uploadFrame = atlasFrame;
+    }
+}
+
+static void ProcessCommandQueue(void) {
+    FWT_PROFILE_SCOPE("ProcessCommandQueue");
+    UploadAtlasPages();
+    ProcessCommandBuffer(&state.commandBuffer);
+
+    int count = state.threadCommandBufferCount;
+    fwtCommandBuffer *sorted[MAX_THREAD_COMMAND_BUFFERS];
+    for (int i = 0; i < count; i++) {
+        fwtCommandBuffer *buffer = &state.threadCommandBuffers[i];
+        int j = i;
+        for (; j > 0 && sorted[j - 1]->key > buffer->key; j--)
+            sorted[j] = sorted[j - 1];
+        assert(!j || sorted[j - 1]->key != buffer->key);
+        sorted[j] = buffer;
+    }
+    for (int i = 0; i < count; i++)
+        ProcessCommandBuffer(sorted[i]);
+}
+
+static void ResetCommandBuffer(fwtCommandBuffer *buffer) {
+    assert(!buffer->sortSection);
+    buffer->size = 0;
+    buffer->cursor = 0;
+}
+
+static void ResetCommandQueue(void) {
+    ResetCommandBuffer(&state.commandBuffer);
+    for (int i = 0; i < state.threadCommandBufferCount; i++)
+        ResetCommandBuffer(&state.threadCommandBuffers[i]);
+    state.threadCommandBufferCount = 0;
+    RecycleTextureSlots(&state);
+    atlasFrame++;
+}
+
+// MARK: Texture pack
+
+static void CloseTexturePack(fwtTexturePack *pack) {
+    if (!pack->data)
+        return;
 #if defined(FWT_WINDOWS)
-    size_t newPathSize = libraryPathLength + 4;
-    char *newPath = malloc(sizeof(char) * newPathSize);
-    char *noExt = RemoveExt(state.libraryPath);
-    sprintf(newPath, "%s.tmp.dll", noExt);
-    CopyFile(state.libraryPath, newPath, 0);
-    if (!(state.libraryHandle = dlopen(newPath, RTLD_NOW)))
-        goto BAIL;
-    free(newPath);
-    free(noExt);
-    if (!state.libraryHandle)
+    UnmapViewOfFile(pack->data);
+    CloseHandle(pack->mapping);
+    CloseHandle(pack->file);
+#else
+    munmap(pack->data, pack->size);
+#endif
+    memset(pack, 0, sizeof(fwtTexturePack));
+}
+
+static bool OpenTexturePack(fwtTexturePack *pack, const char *path) {
+    memset(pack, 0, sizeof(fwtTexturePack));
+#if defined(FWT_WINDOWS)
+    pack->file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (pack->file == INVALID_HANDLE_VALUE)
+        return false;
+    LARGE_INTEGER size;
+    GetFileSizeEx(pack->file, &size);
+    pack->size = (size_t)size.QuadPart;
+    if (!(pack->mapping = CreateFileMappingA(pack->file, NULL, PAGE_READONLY, 0, 0, NULL)) ||
+        !(pack->data = MapViewOfFile(pack->mapping, FILE_MAP_READ, 0, 0, 0))) {
+        if (pack->mapping)
+            CloseHandle(pack->mapping);
+        CloseHandle(pack->file);
+        return false;
+    }
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd == -1)
+        return false;
+    struct stat st;
+    if (fstat(fd, &st) == -1 || !st.st_size) {
+        close(fd);
+        return false;
+    }
+    pack->size = (size_t)st.st_size;
+    pack->data = mmap(NULL, pack->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (pack->data == MAP_FAILED) {
+        pack->data = NULL;
+        return false;
+    }
+#endif
+    fwtPackHeader *header = pack->data;
+#if defined(FWT_TEXTURE_BGRA)
+    uint32_t bgra = 1;
 #else
-    if (!(state.libraryHandle = dlopen(path, RTLD_NOW)))
+    uint32_t bgra = 0;
+#endif
+    if (pack->size < sizeof(fwtPackHeader) ||
+        header->magic != TEXTURE_PACK_MAGIC ||
+        header->version != TEXTURE_PACK_VERSION ||
+        header->bgra != bgra ||
+        pack->size < sizeof(fwtPackHeader) + header->count * sizeof(fwtPackEntry)) {
+        fprintf(stderr, "[TEXTURE ERROR] \"%s\" is out of date, run `make assets`\n", path);
+        CloseTexturePack(pack);
+        return false;
+    }
+    pack->entries = (const fwtPackEntry*)(header + 1);
+    pack->count = header->count;
+    return true;
+}
+
+// MARK: Texture loader
+
+static void* TextureLoaderThread(void *arg) {
+    fwtTextureLoader *loader = &state.textureLoader;
+    for (;;) {
+        pthread_mutex_lock(&loader->lock);
+        while (loader->running && !loader->pending)
+            pthread_cond_wait(&loader->wake, &loader->lock);
+        if (!loader->running) {
+            pthread_mutex_unlock(&loader->lock);
+            return NULL;
+        }
+        fwtTextureJob *job = loader->pending;
+        if (!(loader->pending = job->next))
+            loader->pendingTail = NULL;
+        pthread_mutex_unlock(&loader->lock);
+
+        FWT_PROFILE_SCOPE("LoadTexture");
+        size_t size = 0;
+        unsigned char *data = (unsigned char*)LoadFile(job->path, &size);
+        if (data) {
+            uint64_t hash = MurmurHash(data, size, 0);
+            // Editors often touch a file without changing it, only decode real changes
+            if (!job->reload || hash != job->contentHash)
+                if (!(job->pixels = LoadImage(data, (int)size, &job->w, &job->h)))
+                    fprintf(stderr, "[TEXTURE ERROR] Failed to decode \"%s\"\n", job->path);
+            job->contentHash = hash;
+            free(data);
+        } else
+            fprintf(stderr, "[TEXTURE ERROR] Failed to load \"%s\"\n", job->path);
+
+        job->next = __atomic_load_n(&loader->completed, __ATOMIC_RELAXED);
+        while (!__atomic_compare_exchange_n(&loader->completed, &job->next, job, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+    }
+}
+
+static void InitTextureLoader(void) {
+    static unsigned int checkerboard[4] = {0xFFFF00FF, 0xFF000000, 0xFF000000, 0xFFFF00FF};
+    placeholderImage = ImmutableTexture((int*)checkerboard, 2, 2).internal;
+
+    fwtTextureLoader *loader = &state.textureLoader;
+    pthread_mutex_init(&loader->lock, NULL);
+    pthread_cond_init(&loader->wake, NULL);
+    loader->running = true;
+    for (int i = 0; i < TEXTURE_LOADER_THREADS; i++)
+        pthread_create(&loader->threads[i], NULL, TextureLoaderThread, NULL);
+}
+
+static void FreeTextureJobs(fwtTextureJob *job) {
+    while (job) {
+        fwtTextureJob *next = job->next;
+        free(job->pixels);
+        free(job);
+        job = next;
+    }
+}
+
+static void DeinitTextureLoader(void) {
+    fwtTextureLoader *loader = &state.textureLoader;
+    pthread_mutex_lock(&loader->lock);
+    loader->running = false;
+    pthread_cond_broadcast(&loader->wake);
+    pthread_mutex_unlock(&loader->lock);
+    for (int i = 0; i < TEXTURE_LOADER_THREADS; i++)
+        pthread_join(loader->threads[i], NULL);
+    FreeTextureJobs(loader->pending);
+    FreeTextureJobs(loader->completed);
+    FreeTextureJobs(loader->uploads);
+    pthread_mutex_destroy(&loader->lock);
+    pthread_cond_destroy(&loader->wake);
+}
+
+// Swaps new pixels into an existing texture, its handle (and atlas region) stays the same
+static void ReloadTexture(fwtTexture *texture, int *pixels, int w, int h) {
+    if (texture->page) {
+        if (texture->w != w || texture->h != h) {
+            fprintf(stderr, "[TEXTURE ERROR] Packed textures can't change size on reload\n");
+            return;
+        }
+        for (int i = 0; i < state.atlasPageCount; i++) {
+            fwtAtlasPage *page = &state.atlasPages[i];
+            if (page->texture != texture->page - 1)
+                continue;
+            for (int row = 0; row < h; row++)
+                memcpy(page->pixels + (texture->y + row) * DEFAULT_ATLAS_PAGE_SIZE + texture->x,
+                       pixels + row * w,
+                       w * sizeof(int));
+            page->dirty = true;
+            break;
+        }
+        return;
+    }
+    // Loaded textures are immutable, swap them for a stream texture that UpdateTexture can write
+    if (texture->internal.id == SG_INVALID_ID ||
+        sg_query_image_desc(texture->internal).usage != SG_USAGE_STREAM) {
+        DestroyTexture(texture);
+        *texture = EmptyTexture(w, h);
+    }
+    UpdateTexture(texture, pixels, w, h);
+}
+
+#if !defined(FWT_DISABLE_HOTRELOAD)
+static fwtFileChanges assetChanges = {.lock = PTHREAD_MUTEX_INITIALIZER};
+
+static void AssetWatchCallback(dmon_watch_id watch_id,
+                               dmon_action action,
+                               const char* rootdir,
+                               const char* filepath,
+                               const char* oldfilepath,
+                               void* user) {
+    if (action != DMON_ACTION_DELETE)
+        RecordFileChange(&assetChanges, filepath);
+}
+
+static void ReloadChangedAssets(void) {
+    FWT_PROFILE_SCOPE("ReloadChangedAssets");
+    char name[MAX_PATH];
+    while (TakeFileChange(&assetChanges, name)) {
+        // Only files that back a live texture are reloaded, anything else is ignored
+        uint64_t texture = fwtFindTexture(&state, name);
+        if (!texture)
+            continue;
+        fwtTextureJob *job = calloc(1, sizeof(fwtTextureJob));
+        assert(job);
+        job->texture = texture;
+        job->contentHash = state.textureSlots[TEXTURE_INDEX(texture)].contentHash;
+        job->reload = true;
+        snprintf(job->path, MAX_PATH, "%s/%s", FWT_ASSETS_PATH, name);
+        QueueTextureJob(&state.textureLoader, job);
+    }
+}
+#endif
+
+static void UploadLoadedTextures(void) {
+    FWT_PROFILE_SCOPE("UploadLoadedTextures");
+    fwtTextureLoader *loader = &state.textureLoader;
+    // Completed jobs come off the stack newest first, reverse them to keep load order
+    fwtTextureJob *completed = __atomic_exchange_n(&loader->completed, NULL, __ATOMIC_ACQUIRE);
+    fwtTextureJob *reversed = NULL, *tail = completed;
+    while (completed) {
+        fwtTextureJob *next = completed->next;
+        completed->next = reversed;
+        reversed = completed;
+        completed = next;
+    }
+    if (reversed) {
+        if (loader->uploadsTail)
+            loader->uploadsTail->next = reversed;
+        else
+            loader->uploads = reversed;
+        loader->uploadsTail = tail;
+    }
+
+    uint64_t start = stm_now();
+    size_t uploaded = 0;
+    while (loader->uploads) {
+        fwtTextureJob *job = loader->uploads;
+        size_t size = (size_t)job->w * job->h * sizeof(int);
+        // Always upload at least one texture a frame so large images can't stall forever
+        if (uploaded && (uploaded + size > DEFAULT_TEXTURE_UPLOAD_BYTES ||
+                         stm_ms(stm_since(start)) > DEFAULT_TEXTURE_UPLOAD_MS))
+            break;
+        if (!(loader->uploads = job->next))
+            loader->uploadsTail = NULL;
+        // The texture may have been destroyed while it was loading. A failed decode keeps
+        // the old image and content hash, the next change to the file is decoded again
+        if (job->pixels && fwtIsTextureValid(&state, job->texture)) {
+            uint32_t index = TEXTURE_INDEX(job->texture);
+            if (job->reload)
+                ReloadTexture(&state.textures[index], job->pixels, job->w, job->h);
+            else
+                state.textures[index] = ImmutableTexture(job->pixels, job->w, job->h);
+            state.textureSlots[index].contentHash = job->contentHash;
+            uploaded += size;
+        }
+        free(job->pixels);
+        free(job);
+    }
+}
+
+// MARK: Program loop
+
+// FWT_BENCH keeps the loop in headless builds, minus anything that needs sokol_app (see etc/bench.c)
+#if !defined(FWT_HEADLESS) || defined(FWT_BENCH)
+
+// Applies an event to the input state and queues it for the scenes' next frame
+static void DispatchEvent(const sapp_event *e, uint64_t timestamp) {
+    // Valid in every key, char and mouse event, kept until the next one changes it
+    if (e->type >= SAPP_EVENTTYPE_KEY_DOWN && e->type <= SAPP_EVENTTYPE_MOUSE_LEAVE)
+        state.modifiers = e->modifiers;
+    switch (e->type) {
+    case SAPP_EVENTTYPE_KEY_DOWN:
+    case SAPP_EVENTTYPE_KEY_UP:
+        state.keyboard[e->key_code].down = e->type == SAPP_EVENTTYPE_KEY_DOWN;
+        state.keyboard[e->key_code].timestamp = timestamp;
+        break;
+    case SAPP_EVENTTYPE_MOUSE_DOWN:
+    case SAPP_EVENTTYPE_MOUSE_UP:
+        state.mouse.buttons[e->mouse_button].down = e->type == SAPP_EVENTTYPE_MOUSE_DOWN;
+        state.mouse.buttons[e->mouse_button].timestamp = timestamp;
+        break;
+    case SAPP_EVENTTYPE_MOUSE_SCROLL:
+        state.mouse.scroll.x = e->scroll_x;
+        state.mouse.scroll.y = e->scroll_y;
+        break;
+    case SAPP_EVENTTYPE_MOUSE_MOVE:
+        memcpy(&state.mouse.lastPosition, &state.mouse.position, 2 * sizeof(int));
+        state.mouse.position.x = e->mouse_x;
+        state.mouse.position.y = e->mouse_y;
+        break;
+#if !defined(FWT_HEADLESS)
+    case SAPP_EVENTTYPE_CLIPBOARD_PASTED: {
+        state.clipboard[0] = '\0';
+        const char *buffer = sapp_get_clipboard_string();
+        memcpy(state.clipboard, buffer, strlen(buffer) * sizeof(char));
+        break;
+    }
+    case SAPP_EVENTTYPE_FILES_DROPPED:
+        state.droppedCount = sapp_get_num_dropped_files();
+        for (int i = 0; i < state.droppedCount; i++)
+            state.dropped[i] = sapp_get_dropped_file_path(i);
+        break;
 #endif
-        goto BAIL;
-    if (!(state.libraryScene = dlsym(state.libraryHandle, "scene")))
-        goto BAIL;
-    if (!state.libraryContext) {
-        if (!(state.libraryContext = state.libraryScene->init(&state)))
-            goto BAIL;
-    } else {
-        if (state.libraryScene->reload)
-            state.libraryScene->reload(&state, state.libraryContext);
+    case SAPP_EVENTTYPE_RESIZED:
+        state.windowWidth = e->window_width;
+        state.windowHeight = e->window_height;
+    default:
+        break;
     }
-    state.libraryPath = path;
-    return true;
 
-BAIL:
-    if (state.libraryHandle)
-        dlclose(state.libraryHandle);
-    state.libraryHandle = NULL;
-#if defined(FWT_WINDOWS)
-    memset(&state.libraryWriteTime, 0, sizeof(FILETIME));
-#else
-    state.libraryHandleID = 0;
-#endif
-    return false;
+    // Back to back moves are folded into one so a fast mouse can't fill the queue
+    sapp_event *last = state.eventCount ? &state.events[state.eventCount - 1] : NULL;
+    if (last && last->type == SAPP_EVENTTYPE_MOUSE_MOVE && e->type == SAPP_EVENTTYPE_MOUSE_MOVE) {
+        float dx = last->mouse_dx + e->mouse_dx, dy = last->mouse_dy + e->mouse_dy;
+        *last = *e;
+        last->mouse_dx = dx;
+        last->mouse_dy = dy;
+    } else if (state.eventCount < MAX_FRAME_EVENTS)
+        state.events[state.eventCount++] = *e;
+    else
+        state.droppedEvents++;
 }
 
-static void Usage(const char *name) {
-    printf("  usage: %s [options]\n\n  options:\n", name);
-    printf("\t  help (flag) -- Show this message\n");
-    printf("\t  config (string) -- Path to .json config file\n");
-#define X(NAME, TYPE, VAL, DEFAULT, DOCS) \
-    printf("\t  %s (%s) -- %s (default: %d)\n", NAME, #TYPE, DOCS, DEFAULT);
-    SETTINGS
-#undef X
-}
+// Events are written with the number of frames run before them, a replay feeds them back at the
+// start of the same frame with their original timestamps. Frames are pinned to a fixed delta
+// while replaying, so a recording plays out the same way every time
+static struct {
+    FILE *record, *replay;
+    fwtRecordedEvent events[INPUT_RECORDING_EVENTS]; // Ring of events not written out yet
+    uint64_t head, tail;
+    uint64_t frame; // FrameCallback calls since recording or replaying started
+    fwtRecordedEvent next; // Next event to replay
+} inputRecording;
 
-static int LoadConfig(const char *path) {
-    const char *data = NULL;
-    if (!(data = LoadFile(path, NULL)))
-        return 0;
+static void FlushInputRecording(void) {
+    while (inputRecording.tail < inputRecording.head) {
+        uint64_t index = inputRecording.tail % INPUT_RECORDING_EVENTS;
+        uint64_t count = inputRecording.head - inputRecording.tail;
+        if (count > INPUT_RECORDING_EVENTS - index)
+            count = INPUT_RECORDING_EVENTS - index;
+        fwrite(&inputRecording.events[index], sizeof(fwtRecordedEvent), count, inputRecording.record);
+        inputRecording.tail += count;
+    }
+}
 
-    const struct json_attr_t config_attr[] = {
-#define X(NAME, TYPE, VAL, DEFAULT,DOCS) \
-        {(char*)#NAME, t_##TYPE, .addr.TYPE=&state.desc.VAL},
-        SETTINGS
-#undef X
-        {NULL}
+static void RecordEvent(const sapp_event *e, uint64_t timestamp) {
+    if (!inputRecording.record)
+        return;
+    // Their payload lives in sokol_app, not in the event
+    if (e->type == SAPP_EVENTTYPE_CLIPBOARD_PASTED || e->type == SAPP_EVENTTYPE_FILES_DROPPED)
+        return;
+    if (inputRecording.head - inputRecording.tail == INPUT_RECORDING_EVENTS)
+        FlushInputRecording();
+    inputRecording.events[inputRecording.head++ % INPUT_RECORDING_EVENTS] = (fwtRecordedEvent) {
+        .frame = inputRecording.frame,
+        .timestamp = timestamp,
+        .event = *e
     };
-    int status = json_read_object(data, config_attr, NULL);
-    if (!status)
-        return 0;
-    free((void*)data);
-    return 1;
 }
 
-#define jim_boolean jim_bool
-
-static int ExportConfig(const char *path) {
-    FILE *fh = fopen(path, "w");
-    if (!fh)
-        return 0;
-    Jim jim = {
-        .sink = fh,
-        .write = (Jim_Write)fwrite
+static void BeginInputRecording(const char *path) {
+    FILE *fh = fopen(path, "wb");
+    if (!fh) {
+        fprintf(stderr, "[INPUT ERROR] Failed to open \"%s\"\n", path);
+        return;
+    }
+    fwtInputRecordingHeader header = {
+        .magic = INPUT_RECORDING_MAGIC,
+        .version = INPUT_RECORDING_VERSION,
+        .eventSize = sizeof(sapp_event),
+        .delta = state.frameDelta
     };
-    jim_object_begin(&jim);
-#define X(NAME, TYPE, VAL, DEFAULT, DOCS) \
-    jim_member_key(&jim, NAME);           \
-    jim_##TYPE(&jim, state.desc.VAL);
-    SETTINGS
-#undef X
-    jim_object_end(&jim);
-    fclose(fh);
-    return 1;
+    fwrite(&header, sizeof(header), 1, fh);
+    inputRecording.record = fh;
 }
 
-static int ParseArguments(int argc, char *argv[]) {
-    const char *name = argv[0];
-    sargs_desc desc = (sargs_desc) {
-#if defined FWT_EMSCRIPTEN
-        .argc = argc,
-        .argv = (char**)argv
-#else
-        .argc = argc - 1,
-        .argv = (char**)(argv + 1)
-#endif
-    };
-    sargs_setup(&desc);
+static void EndInputRecording(void) {
+    if (!inputRecording.record)
+        return;
+    RecordEvent(&(sapp_event) {.type = SAPP_EVENTTYPE_INVALID}, stm_now());
+    FlushInputRecording();
+    fclose(inputRecording.record);
+    inputRecording.record = NULL;
+}
 
-#if !defined(FWT_EMSCRIPTEN)
-    if (sargs_exists("help")) {
-        Usage(name);
-        return 0;
+static void EndInputReplay(void) {
+    if (!inputRecording.replay)
+        return;
+    fclose(inputRecording.replay);
+    inputRecording.replay = NULL;
+}
+
+static void BeginInputReplay(const char *path) {
+    FILE *fh = fopen(path, "rb");
+    fwtInputRecordingHeader header;
+    if (!fh || fread(&header, sizeof(header), 1, fh) != 1 ||
+        header.magic != INPUT_RECORDING_MAGIC || header.version != INPUT_RECORDING_VERSION ||
+        header.eventSize != sizeof(sapp_event)) {
+        fprintf(stderr, "[INPUT ERROR] \"%s\" is not an input recording from this version\n", path);
+        if (fh)
+            fclose(fh);
+        return;
     }
-    if (sargs_exists("config")) {
-        const char *path = sargs_value("config");
-        if (!path) {
-            fprintf(stderr, "[ARGUMENT ERROR] No value passed for \"config\"\n");
-            Usage(name);
-            return 0;
-        }
-        if (!DoesFileExist(path)) {
-            fprintf(stderr, "[FILE ERROR] No file exists at \"%s\"\n", path);
-            Usage(name);
-            return 0;
+    inputRecording.replay = fh;
+    // A delta pinned by the caller (like the benchmark's) wins over the recording's
+    if (state.frameDelta <= 0.0)
+        state.frameDelta = header.delta > 0.0 ? header.delta : 1.0 / state.tickRate;
+    if (fread(&inputRecording.next, sizeof(fwtRecordedEvent), 1, fh) != 1)
+        EndInputReplay();
+}
+
+static void ReplayInput(void) {
+    while (inputRecording.replay && inputRecording.next.frame <= inputRecording.frame) {
+        if (inputRecording.next.event.type == SAPP_EVENTTYPE_INVALID) {
+            // The recording stopped here, so does the replay
+            EndInputReplay();
+#if !defined(FWT_HEADLESS)
+            sapp_request_quit();
+#endif
+            return;
         }
-        LoadConfig(path);
-    }
-#endif // FWT_EMSCRIPTEN
-
-#define boolean 1
-#define integer 0
-#define X(NAME, TYPE, VAL, DEFAULT, DOCS)                                               \
-    if (sargs_exists(NAME))                                                             \
-    {                                                                                   \
-        const char *tmp = sargs_value_def(NAME, #DEFAULT);                              \
-        if (!tmp)                                                                       \
-        {                                                                               \
-            fprintf(stderr, "[ARGUMENT ERROR] No value passed for \"%s\"\n", NAME);     \
-            Usage(name);                                                                \
-            return 0;                                                                   \
-        }                                                                               \
-        if (TYPE == 1)                                                                  \
-            state.desc.VAL = (int)atoi(tmp);                                            \
-        else                                                                            \
-            state.desc.VAL = sargs_boolean(NAME);                                       \
+        DispatchEvent(&inputRecording.next.event, inputRecording.next.timestamp);
+        if (fread(&inputRecording.next, sizeof(fwtRecordedEvent), 1, inputRecording.replay) != 1)
+            EndInputReplay();
     }
-    SETTINGS
-#undef X
-#undef boolean
-#undef integer
-    return 1;
 }
 
-// MARK: Program loop
+// Writes happen between frames once the ring is half full, not while events are arriving
+static void EndInputFrame(void) {
+    inputRecording.frame++;
+    if (inputRecording.record && inputRecording.head - inputRecording.tail >= INPUT_RECORDING_EVENTS / 2)
+        FlushInputRecording();
+}
 
 static void InitCallback(void) {
+    state.mainThread = pthread_self();
     sg_desc desc = (sg_desc) {
+#if !defined(FWT_HEADLESS)
         // TODO: Add more configuration options for sg_desc
         .context = sapp_sgcontext()
+#endif
     };
     sg_setup(&desc);
     stm_setup();
-    sgp_desc desc_sgp = (sgp_desc) {};
+    sgp_desc desc_sgp = (sgp_desc) {
+        .max_vertices = DEFAULT_MAX_VERTICES,
+        .max_commands = DEFAULT_MAX_COMMANDS
+    };
     sgp_setup(&desc_sgp);
     assert(sg_isvalid() && sgp_is_valid());
+    InitTextureLoader();
+    OpenTexturePack(&state.texturePack, FWT_ASSETS_PACK_PATH);
 #if !defined(FWT_DISABLE_HOTRELOAD)
     dmon_init();
-//    dmon_watch(FWT_ASSETS_PATH_IN, AssetWatchCallback, DMON_WATCHFLAGS_IGNORE_DIRECTORIES, NULL);
+    dmon_watch(FWT_ASSETS_PATH, AssetWatchCallback, DMON_WATCHFLAGS_RECURSIVE, NULL);
+    dmon_watch(FWT_DYLIB_PATH, LibraryWatchCallback, 0, NULL);
+#if defined(FWT_REBUILD_SCENES)
+    dmon_watch(FWT_SCENES_PATH, SceneWatchCallback, 0, NULL);
+#endif
 #endif
 
-    state.textureMapCapacity = 1;
-    state.textureMapCount = 0;
-    state.textureMap = imap_ensure(NULL, 1);
+#if defined(FWT_HEADLESS)
+    state.windowWidth = state.desc.width;
+    state.windowHeight = state.desc.height;
+#else
     state.windowWidth = sapp_width();
     state.windowHeight = sapp_height();
+#endif
     state.clearColor = (sg_color){0.39f, 0.58f, 0.92f, 1.f};
-
-    state.nextScene = NULL;
-    fwtSwapToScene(&state, FWT_FIRST_SCENE);
+    state.prevFrameTime = stm_now();
+    // Without vsync nothing else paces frames
+    if (!state.desc.swap_interval)
+        state.targetFPS = DEFAULT_TARGET_FPS;
+
+    // Anything swapped to before init (like the benchmark's scene) replaces the first scene
+    if (!state.nextScene)
+        fwtSwapToScene(&state, FWT_FIRST_SCENE);
     assert(ReloadLibrary(state.nextScene));
+    state.nextScene = NULL;
+
+    // Started once the first scene is in, frame 0 is the first FrameCallback
+    const char *recordInput = fwtArgument(&state, "recordInput", NULL);
+    if (recordInput)
+        BeginInputRecording(recordInput);
+    const char *replayInput = fwtArgument(&state, "replayInput", NULL);
+    if (replayInput)
+        BeginInputReplay(replayInput);
 }
 
-static void ProcessCommandQueue(void) {
-    while (state.commandQueue.front) {
-        fwtCommand *command = (fwtCommand*)state.commandQueue.front->data;
-        ProcessCommand(command);
-        FreeCommand(command);
-        ezStackEntry *head = ezStackShift(&state.commandQueue);
-        free(head);
+static void RecordFrameTime(double delta) {
+    fwtFrameTimings *timings = &state.frameTimings;
+    timings->samples[timings->cursor] = (float)(delta * 1000.0);
+    timings->cursor = (timings->cursor + 1) % FRAME_TIMING_SAMPLES;
+    if (timings->count < FRAME_TIMING_SAMPLES)
+        timings->count++;
+}
+
+static void SleepFor(double seconds) {
+#if defined(FWT_WINDOWS)
+    Sleep((DWORD)(seconds * 1000.0));
+#else
+    struct timespec ts = {
+        .tv_sec = (time_t)seconds,
+        .tv_nsec = (long)((seconds - (time_t)seconds) * 1e9)
+    };
+#if defined(FWT_LINUX)
+    while (clock_nanosleep(CLOCK_MONOTONIC, 0, &ts, &ts) == EINTR);
+#else
+    while (nanosleep(&ts, &ts) == -1 && errno == EINTR);
+#endif
+#endif
+}
+
+// Sleeps most of the way to the deadline and spins the rest, sleeping alone can
+// overshoot by a whole scheduler quantum
+static void PaceFrame(void) {
+    FWT_PROFILE_SCOPE("PaceFrame");
+    fwtFrameTimings *timings = &state.frameTimings;
+    if (state.targetFPS <= 0.0) {
+        timings->deadline = 0;
+        return;
+    }
+    uint64_t period = (uint64_t)(1e9 / state.targetFPS); // sokol_time ticks are nanoseconds
+    uint64_t now = stm_now();
+    if (!timings->deadline) {
+        timings->deadline = now + period;
+        return;
     }
+    if (now > timings->deadline) {
+        timings->missedDeadlines++;
+        // More than a frame behind, resync instead of rushing the next frames to catch up
+        timings->deadline = now - timings->deadline > period ? now + period : timings->deadline + period;
+        return;
+    }
+
+    double remaining = stm_sec(timings->deadline - now);
+    double spin = DEFAULT_FRAME_SPIN_MS / 1000.0;
+    if (remaining > spin)
+        SleepFor(remaining - spin);
+    while (stm_now() < timings->deadline);
+    timings->deadline += period;
+}
+
+static void DrawUsageBar(float x, float y, uint32_t used, uint32_t capacity, bool failed) {
+    float usage = capacity ? fminf((float)used / capacity, 1.f) : 0.f;
+    sgp_set_color(0.f, 0.f, 0.f, .6f);
+    sgp_draw_filled_rect(x, y, 200.f, 8.f);
+    if (failed)
+        sgp_set_color(1.f, 0.f, 0.f, 1.f);
+    else
+        sgp_set_color(usage, 1.f - usage, 0.f, 1.f);
+    sgp_draw_filled_rect(x + 1.f, y + 1.f, 198.f * usage, 6.f);
+}
+
+// There's no text rendering yet, so everything is bars: vertices, commands and uniforms against
+// sokol_gp's limits, then the share of draws merged into a batch, then the frame time history
+static void DrawStatsOverlay(void) {
+    fwtFrameStats *stats = &state.frameStats;
+    bool failed = stats->error != SGP_NO_ERROR;
+    sgp_reset_state();
+    sgp_reset_image(0);
+    ResetImageOffsets();
+    sgp_set_blend_mode(SGP_BLENDMODE_BLEND);
+    DrawUsageBar(8.f, 8.f, stats->vertices, stats->maxVertices, failed);
+    DrawUsageBar(8.f, 20.f, stats->sgpCommands, stats->maxCommands, failed);
+    DrawUsageBar(8.f, 32.f, stats->uniforms, stats->maxUniforms, failed);
+    float merged = stats->draws ? (float)stats->mergedBatches / stats->draws : 0.f;
+    sgp_set_color(0.f, 0.f, 0.f, .6f);
+    sgp_draw_filled_rect(8.f, 44.f, 200.f, 8.f);
+    sgp_set_color(.2f, .5f, 1.f, 1.f);
+    sgp_draw_filled_rect(9.f, 45.f, 198.f * merged, 6.f);
+
+    // One column per frame, 2px per millisecond, the line is the target frame time
+    fwtFrameTimings *timings = &state.frameTimings;
+    float top = 56.f, height = 66.f;
+    sgp_set_color(0.f, 0.f, 0.f, .6f);
+    sgp_draw_filled_rect(8.f, top, 200.f, height);
+    uint32_t columns = timings->count < 200 ? timings->count : 200;
+    for (uint32_t i = 0; i < columns; i++) {
+        uint32_t index = (timings->cursor + FRAME_TIMING_SAMPLES - columns + i) % FRAME_TIMING_SAMPLES;
+        float h = fminf(timings->samples[index] * 2.f, height);
+        bool over = state.targetFPS > 0.0 && timings->samples[index] > 1000.0 / state.targetFPS + .5f;
+        sgp_set_color(over ? 1.f : .8f, over ? .3f : .8f, over ? .3f : .8f, 1.f);
+        sgp_draw_filled_rect(8.f + i, top + height - h, 1.f, h);
+    }
+    float target = (float)(1000.0 / (state.targetFPS > 0.0 ? state.targetFPS : DEFAULT_TARGET_FPS)) * 2.f;
+    sgp_set_color(0.f, 1.f, 0.f, 1.f);
+    sgp_draw_line(8.f, top + height - target, 208.f, top + height - target);
+    sgp_reset_state();
+    ResetImageOffsets();
 }
 
 static void FrameCallback(void) {
+    FWT_PROFILE_SCOPE("FrameCallback");
+    ReplayInput();
+#if !defined(FWT_HEADLESS)
     if (state.fullscreen != state.fullscreenLast) {
         sapp_toggle_fullscreen();
         state.fullscreenLast = state.fullscreen;
@@ -1413,101 +3421,171 @@ static void FrameCallback(void) {
         sapp_lock_mouse(state.cursorLocked);
         state.cursorLockedLast = state.cursorLocked;
     }
+#endif
 
-    if (state.nextScene) {
-        assert(ReloadLibrary(state.nextScene));
-        state.nextScene = NULL;
-    } else
+    // Libraries are opened on loader threads and only swapped in here, between frames
+    ProcessSceneRequests();
+    ProcessLoadedScenes();
 #if !defined(FWT_DISABLE_HOTRELOAD)
-        assert(ReloadLibrary(state.libraryPath));
+    if (LibraryChanged())
+        ReloadResidentScenes();
+#if defined(FWT_REBUILD_SCENES)
+    RebuildChangedScenes();
+#endif
 #endif
 
-    if (state.libraryScene->preframe) {
-        state.libraryScene->preframe(&state, state.libraryContext);
+#if !defined(FWT_DISABLE_HOTRELOAD)
+    ReloadChangedAssets();
+#endif
+    UploadLoadedTextures();
+
+    // The primary scene and any attached scenes, lowest order first (and drawn first)
+    fwtResidentScene *scenes[MAX_RESIDENT_SCENES];
+    int sceneCount = TickingScenes(scenes);
+
+    BeginCapture();
+    if (state.eventCount)
+        for (int i = 0; i < sceneCount; i++)
+            if (scenes[i]->library.scene->event) {
+                FWT_PROFILE_SCOPE("event");
+                scenes[i]->library.scene->event(&state, scenes[i]->context, state.events, state.eventCount);
+            }
+    bool preframe = false;
+    for (int i = 0; i < sceneCount; i++)
+        if (scenes[i]->library.scene->preframe) {
+            FWT_PROFILE_SCOPE("preframe");
+            scenes[i]->library.scene->preframe(&state, scenes[i]->context);
+            preframe = true;
+        }
+    if (preframe)
         ProcessCommandQueue();
-    }
 
-    int64_t current_frame_time = stm_now();
-    int64_t delta_time = current_frame_time - state.prevFrameTime;
-    state.prevFrameTime = current_frame_time;
-    if (state.libraryScene->update)
-        state.libraryScene->update(&state, state.libraryContext, delta);
+    uint64_t now = stm_now();
+    double delta = state.frameDelta > 0.0 ? state.frameDelta : stm_sec(stm_diff(now, state.prevFrameTime));
+    state.prevFrameTime = now;
+    RecordFrameTime(delta);
+    for (int i = 0; i < sceneCount; i++)
+        if (scenes[i]->library.scene->update) {
+            FWT_PROFILE_SCOPE("update");
+            scenes[i]->library.scene->update(&state, scenes[i]->context, (float)delta);
+        }
+
+    // Simulation runs at the tick rate whatever the refresh rate, frame() interpolates
+    double step = 1.0 / state.tickRate;
+    state.fixedAccumulator += delta;
+    for (int ticks = 0; state.fixedAccumulator >= step; ticks++) {
+        if (ticks == MAX_FIXED_UPDATES_PER_FRAME) {
+            state.fixedAccumulator = fmod(state.fixedAccumulator, step);
+            break;
+        }
+        for (int i = 0; i < sceneCount; i++)
+            if (scenes[i]->library.scene->fixedupdate) {
+                FWT_PROFILE_SCOPE("fixedupdate");
+                scenes[i]->library.scene->fixedupdate(&state, scenes[i]->context, (float)step);
+            }
+        state.fixedAccumulator -= step;
+    }
+    float alpha = (float)(state.fixedAccumulator / step);
 
     sgp_begin(state.windowWidth, state.windowHeight);
-    if (state.libraryScene->frame)
-        state.libraryScene->frame(&state, state.libraryContext, render_time);
+    ResetImageOffsets();
+    for (int i = 0; i < sceneCount; i++)
+        if (scenes[i]->library.scene->frame) {
+            FWT_PROFILE_SCOPE("frame");
+            scenes[i]->library.scene->frame(&state, scenes[i]->context, alpha);
+        }
     ProcessCommandQueue();
+    EndCapture();
+    CollectFrameStats();
+    if (state.statsOverlay)
+        DrawStatsOverlay();
 
     state.pass_action.colors[0].clear_value = state.clearColor;
     sg_begin_default_pass(&state.pass_action, state.windowWidth, state.windowHeight);
-    sgp_flush();
-    sgp_end();
+    {
+        FWT_PROFILE_SCOPE("sgp_flush");
+        sgp_flush();
+        // Flush draws nothing once the queue has overflowed, so this catches draws dropped anywhere in the frame
+        if ((state.frameStats.error = sgp_get_last_error()) != SGP_NO_ERROR)
+            state.frameStats.errorFrames++;
+        sgp_end();
+    }
     sg_end_pass();
     sg_commit();
+    ResetCommandQueue();
 
-    state.modifiers = 0;
+    state.eventCount = 0;
     state.mouse.scroll.x = 0.f;
     state.mouse.scroll.y = 0.f;
 
-    if (state.libraryScene->postframe)
-        state.libraryScene->postframe(&state, state.libraryContext);
+    for (int i = 0; i < sceneCount; i++)
+        if (scenes[i]->library.scene->postframe) {
+            FWT_PROFILE_SCOPE("postframe");
+            scenes[i]->library.scene->postframe(&state, scenes[i]->context);
+        }
+
+    EndInputFrame();
+    PaceFrame();
 }
 
 static void EventCallback(const sapp_event* e) {
-    switch (e->type) {
-    case SAPP_EVENTTYPE_KEY_DOWN:
-    case SAPP_EVENTTYPE_KEY_UP:
-        state.keyboard[e->key_code].down = e->type == SAPP_EVENTTYPE_KEY_DOWN;
-        state.keyboard[e->key_code].timestamp = stm_now();
-        state.modifiers = e->modifiers;
-        return;
-    case SAPP_EVENTTYPE_MOUSE_DOWN:
-    case SAPP_EVENTTYPE_MOUSE_UP:
-        state.mouse.buttons[e->mouse_button].down = e->type == SAPP_EVENTTYPE_MOUSE_DOWN;
-        state.mouse.buttons[e->mouse_button].timestamp = stm_now();
-        state.modifiers = e->modifiers;
-        return;
-    case SAPP_EVENTTYPE_MOUSE_SCROLL:
-        state.mouse.scroll.x = e->scroll_x;
-        state.mouse.scroll.y = e->scroll_y;
-        return;
-    case SAPP_EVENTTYPE_MOUSE_MOVE:
-        memcpy(&state.mouse.lastPosition, &state.mouse.position, 2 * sizeof(int));
-        state.mouse.position.x = e->mouse_x;
-        state.mouse.position.y = e->mouse_y;
+    // Live input would desync a replay, window events still go through
+    if (inputRecording.replay && e->type >= SAPP_EVENTTYPE_KEY_DOWN && e->type <= SAPP_EVENTTYPE_TOUCHES_CANCELLED)
         return;
-    case SAPP_EVENTTYPE_CLIPBOARD_PASTED: {
-        state.clipboard[0] = '\0';
-        const char *buffer = sapp_get_clipboard_string();
-        memcpy(state.clipboard, buffer, strlen(buffer) * sizeof(char));
-        break;
-    }
-    case SAPP_EVENTTYPE_FILES_DROPPED:
-        state.droppedCount = sapp_get_num_dropped_files();
-        for (int i = 0; i < state.droppedCount; i++)
-            state.dropped[i] = sapp_get_dropped_file_path(i);
-        break;
-    case SAPP_EVENTTYPE_RESIZED:
-        state.windowWidth = e->window_width;
-        state.windowHeight = e->window_height;
-    default:
-        break;
-    }
-    if (state.libraryScene->event)
-        state.libraryScene->event(&state, state.libraryContext, e->type);
+    uint64_t now = stm_now();
+    RecordEvent(e, now);
+    DispatchEvent(e, now);
 }
 
 static void CleanupCallback(void) {
     state.running = false;
-    if (state.libraryScene->deinit)
-        state.libraryScene->deinit(&state, state.libraryContext);
+    EndInputRecording();
+    EndInputReplay();
+#if defined(FWT_PROFILE_PATH)
+    if (!fwtDumpProfile(FWT_PROFILE_PATH))
+        fprintf(stderr, "[PROFILE ERROR] Failed to write \"%s\"\n", FWT_PROFILE_PATH);
+#endif
 #if !defined(FWT_DISABLE_HOTRELOAD)
     dmon_deinit();
+    free(assetChanges.changes);
+#if defined(FWT_REBUILD_SCENES)
+    free(sceneChanges.changes);
+#endif
 #endif
-    dlclose(state.libraryHandle);
+    WaitForSceneLoads();
+    for (int i = 0; i < residentSceneCount; i++) {
+        if (residentScenes[i].library.scene->deinit)
+            residentScenes[i].library.scene->deinit(&state, residentScenes[i].context);
+        CloseLibrary(&residentScenes[i].library);
+    }
+    residentSceneCount = 0;
+    primaryScene = -1;
+    SyncPrimaryScene();
+    FreeSceneCache();
+    DeinitTextureLoader();
+    free(state.commandBuffer.data);
+    free(capture.data);
+    for (int i = 0; i < MAX_THREAD_COMMAND_BUFFERS; i++)
+        free(state.threadCommandBuffers[i].data);
+    free(sortItems);
+    free(sortScratch);
+    for (uint32_t i = 0; i < state.textureCount; i++)
+        if (state.textureSlots[i].name)
+            DestroyTexture(&state.textures[i]);
+    free(state.textures);
+    free(state.textureSlots);
+    free(state.textureNames);
+    for (int i = 0; i < state.atlasPageCount; i++) {
+        free(state.atlasPages[i].pixels);
+        free(state.atlasPages[i].nodes);
+    }
+    free(state.atlasPages);
+    CloseTexturePack(&state.texturePack);
+    sg_destroy_image(placeholderImage);
     sg_shutdown();
 }
 
+#if !defined(FWT_HEADLESS)
 sapp_desc sokol_main(int argc, char* argv[]) {
 #if defined(FWT_ENABLE_CONFIG)
 #if !defined(FWT_CONFIG_PATH)
@@ -1539,6 +3617,8 @@ sapp_desc sokol_main(int argc, char* argv[]) {
         }
 #endif
 
+    state.argc = argc;
+    state.argv = argv;
     state.desc.init_cb = InitCallback;
     state.desc.frame_cb = FrameCallback;
     state.desc.event_cb = EventCallback;
@@ -1546,16 +3626,37 @@ sapp_desc sokol_main(int argc, char* argv[]) {
     return state.desc;
 }
 #endif
+#endif // FWT_HEADLESS
+#endif
 
-#if defined(FWT_MAC)
-#define DYLIB_EXT ".dylib"
-#elif defined(FWT_WINDOWS)
-#define DYLIB_EXT ".dll"
-#elif defined(FWT_LINUX)
-#define DYLIB_EXT ".so"
-#else
-#error Unsupported operating system
+static void PushSceneRequest(fwtState *state, fwtSceneRequestType type, const char *name, int order) {
+    assert(state->sceneRequestCount < MAX_SCENE_REQUESTS);
+    state->sceneRequests[state->sceneRequestCount++] = (fwtSceneRequest) {
+        .type = type,
+        .name = name,
+        .order = order
+    };
+}
+
+void fwtPreloadScene(fwtState *state, const char *name) {
+    PushSceneRequest(state, fwtScenePreload, name, 0);
+}
+
+void fwtPreloadScenes(fwtState *state) {
+#if defined(FWT_SCENES)
+#define X(NAME) fwtPreloadScene(state, NAME);
+    FWT_SCENES
+#undef X
 #endif
+}
+
+void fwtAttachScene(fwtState *state, const char *name, int order) {
+    PushSceneRequest(state, fwtSceneAttach, name, order);
+}
+
+void fwtDetachScene(fwtState *state, const char *name) {
+    PushSceneRequest(state, fwtSceneDetach, name, 0);
+}
 
 void fwtSwapToScene(fwtState *state, const char *name) {
     const char *ext = FileExt(name);
@@ -1568,6 +3669,68 @@ void fwtSwapToScene(fwtState *state, const char *name) {
     }
 }
 
+void fwtSetTickRate(fwtState *state, double hz) {
+    assert(hz > 0.0);
+    state->tickRate = hz;
+}
+
+double fwtTickRate(fwtState *state) {
+    return state->tickRate;
+}
+
+void fwtCaptureFrame(fwtState *state, const char *path) {
+    snprintf(state->capturePath, MAX_PATH, "%s", path);
+}
+
+// The program and every scene each have their own sokol_args, set up on first use
+const char* fwtArgument(fwtState *state, const char *key, const char *value) {
+    if (!sargs_isvalid()) {
+        if (!state->argv)
+            return value;
+        sargs_setup(&(sargs_desc) {
+            .argc = state->argc,
+            .argv = state->argv
+        });
+    }
+    return sargs_value_def(key, value);
+}
+
+void fwtSetTargetFPS(fwtState *state, double fps) {
+    state->targetFPS = fps > 0.0 ? fps : 0.0;
+    state->frameTimings.deadline = 0;
+}
+
+double fwtTargetFPS(fwtState *state) {
+    return state->targetFPS;
+}
+
+static int CompareFrameTimes(const void *a, const void *b) {
+    float x = *(const float*)a, y = *(const float*)b;
+    return (x > y) - (x < y);
+}
+
+fwtFrameTimingStats fwtFrameTiming(fwtState *state) {
+    const fwtFrameTimings *timings = &state->frameTimings;
+    fwtFrameTimingStats stats = {
+        .missedDeadlines = timings->missedDeadlines,
+        .samples = timings->count
+    };
+    if (!timings->count)
+        return stats;
+
+    float sorted[FRAME_TIMING_SAMPLES];
+    memcpy(sorted, timings->samples, timings->count * sizeof(float));
+    qsort(sorted, timings->count, sizeof(float), CompareFrameTimes);
+    double total = 0.0;
+    for (uint32_t i = 0; i < timings->count; i++)
+        total += sorted[i];
+    stats.mean = total / timings->count;
+    stats.min = sorted[0];
+    stats.max = sorted[timings->count - 1];
+    stats.p99 = sorted[(uint32_t)ceil(timings->count * .99) - 1];
+    return stats;
+}
+
 void fwtWindowSize(fwtState *state, int *width, int *height) {
     if (width)
         *width = state->windowWidth;
@@ -1583,6 +3746,18 @@ void fwtToggleFullscreen(fwtState *state) {
     state->fullscreen = !state->fullscreen;
 }
 
+fwtFrameStats fwtGetFrameStats(fwtState *state) {
+    return state->frameStats;
+}
+
+bool fwtIsStatsOverlayVisible(fwtState *state) {
+    return state->statsOverlay;
+}
+
+void fwtToggleStatsOverlay(fwtState *state) {
+    state->statsOverlay = !state->statsOverlay;
+}
+
 int fwtIsCursorVisible(fwtState *state) {
     return state->cursorVisible;
 }
@@ -1599,9 +3774,12 @@ void fwtToggleCursorLock(fwtState *state) {
     state->cursorLocked = !state->cursorLocked;
 }
 
+// Meant to be called once at load, keep the handle rather than looking it up per draw
 uint64_t fwtFindTexture(fwtState *state, const char *name) {
-    uint64_t hash = MurmurHash((void*)name, strlen(name), 0);
-    return imap_lookup(state->textureMap, hash) ? hash : -1L;
+    if (!state->textureNameCount)
+        return 0;
+    uint32_t entry = *FindTextureName(state, MurmurHash((void*)name, strlen(name), 0));
+    return entry ? TEXTURE_HANDLE(entry - 1, state->textureSlots[entry - 1].generation) : 0;
 }
 
 bool fwtIsKeyDown(fwtState *state, sapp_keycode key) {
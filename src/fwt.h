@@ -80,16 +80,21 @@ typedef enum bool {
 #include <stddef.h>
 #include <stdarg.h>
 #include <string.h>
+#include <time.h>
 #include <sys/stat.h>
 #include <setjmp.h>
 #include <errno.h>
 #include <assert.h>
+#include <pthread.h>
+#include <sched.h>
 #if defined(FWT_POSIX)
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <dirent.h>
 #include <dlfcn.h>
+#include <fcntl.h>
+#include <sys/mman.h>
 #else
 #include "dlfcn_win32.h"
 #ifndef _MSC_VER
@@ -107,6 +112,11 @@ typedef enum bool {
 
 #include "fwt_config.h"
 
+// Cooked from FWT_ASSETS_PATH by `make assets`, mapped at startup when it exists
+#if !defined(FWT_ASSETS_PACK_PATH)
+#define FWT_ASSETS_PACK_PATH FWT_DYLIB_PATH "/assets.pack"
+#endif
+
 #if !defined(DEFAULT_CONFIG_NAME)
 #if defined(FWT_POSIX)
 #define DEFAULT_CONFIG_NAME ".fwt.json"
@@ -135,10 +145,100 @@ typedef enum bool {
 #define FWT_DISABLE_HOTRELOAD
 #endif
 
+#if !defined(TEXTURE_LOADER_THREADS)
+#define TEXTURE_LOADER_THREADS 2
+#endif
+
+// Per-frame limits for uploading textures finished by fwtLoadTextureAsync
+#if !defined(DEFAULT_TEXTURE_UPLOAD_BYTES)
+#define DEFAULT_TEXTURE_UPLOAD_BYTES (8 * 1024 * 1024)
+#endif
+
+#if !defined(DEFAULT_TEXTURE_UPLOAD_MS)
+#define DEFAULT_TEXTURE_UPLOAD_MS 2.0
+#endif
+
+#if !defined(FWT_SCENES_PATH)
+#define FWT_SCENES_PATH "scenes"
+#endif
+
+// Define FWT_REBUILD_SCENES to have the program run `make` for a scene whenever its source
+// in FWT_SCENES_PATH changes, the rebuilt library is then hot reloaded as usual
+
+// Asset and scene library changes are held back until the file has been quiet this long
+#if !defined(DEFAULT_ASSET_RELOAD_DELAY_MS)
+#define DEFAULT_ASSET_RELOAD_DELAY_MS 100.0
+#endif
+
+// Rate `fixedupdate` is called at, independent of the display's refresh rate
+#if !defined(DEFAULT_TICK_RATE)
+#define DEFAULT_TICK_RATE 60.0
+#endif
+
+// After a long stall the remaining fixed steps are dropped rather than caught up
+#if !defined(MAX_FIXED_UPDATES_PER_FRAME)
+#define MAX_FIXED_UPDATES_PER_FRAME 8
+#endif
+
+// Scenes kept loaded and initialised at once, see fwtPreloadScene
+#if !defined(MAX_RESIDENT_SCENES)
+#define MAX_RESIDENT_SCENES 4
+#endif
+
+#if !defined(MAX_SCENE_REQUESTS)
+#define MAX_SCENE_REQUESTS 16
+#endif
+
+#if !defined(DEFAULT_ATLAS_PAGE_SIZE)
+#define DEFAULT_ATLAS_PAGE_SIZE 2048
+#endif
+
+// Gap left between packed images so filtering doesn't bleed into neighbours
+#if !defined(ATLAS_PADDING)
+#define ATLAS_PADDING 1
+#endif
+
+#if !defined(MAX_THREAD_COMMAND_BUFFERS)
+#define MAX_THREAD_COMMAND_BUFFERS 16
+#endif
+
+#if !defined(DEFAULT_COMMAND_BUFFER_SIZE)
+#define DEFAULT_COMMAND_BUFFER_SIZE 65536
+#endif
+
+// sokol_gp queue sizes, the defaults are sokol_gp's own
+#if !defined(DEFAULT_MAX_VERTICES)
+#define DEFAULT_MAX_VERTICES 65536
+#endif
+
+#if !defined(DEFAULT_MAX_COMMANDS)
+#define DEFAULT_MAX_COMMANDS 16384
+#endif
+
 #if !defined(DEFAULT_TARGET_FPS)
 #define DEFAULT_TARGET_FPS 60.f
 #endif
 
+// Frame times kept for fwtFrameTiming (4 seconds at 60 fps)
+#if !defined(FRAME_TIMING_SAMPLES)
+#define FRAME_TIMING_SAMPLES 240
+#endif
+
+// How close to the deadline the limiter stops sleeping and starts spinning
+#if !defined(DEFAULT_FRAME_SPIN_MS)
+#define DEFAULT_FRAME_SPIN_MS 2.0
+#endif
+
+// Recorded input events held in memory before they're written out, see `recordInput`
+#if !defined(INPUT_RECORDING_EVENTS)
+#define INPUT_RECORDING_EVENTS 4096
+#endif
+
+// Events queued between two frames for the scenes' `event`, see fwtState.events
+#if !defined(MAX_FRAME_EVENTS)
+#define MAX_FRAME_EVENTS 256
+#endif
+
 #ifndef MAX_PATH
 #if defined(FWT_MAC)
 #define MAX_PATH 255
@@ -198,11 +298,162 @@ typedef struct fwtRect {
 typedef struct fwtTexture {
     sg_image internal;
     int w, h;
+    uint32_t page; // Atlas page slot + 1 for packed textures, `x`/`y` is the region origin
+    int x, y;
 } fwtTexture;
 
+// Texture handles are (generation << 32 | index) into `fwtState.textures`, 0 is never valid
+typedef struct fwtTextureSlot {
+    uint64_t name;
+    uint64_t contentHash; // Hash of the file it was loaded from, 0 if unknown
+    uint32_t generation;
+    uint32_t nextFree;
+} fwtTextureSlot;
+
+typedef struct fwtSkylineNode {
+    int x, y, w;
+} fwtSkylineNode;
+
+typedef struct fwtAtlasPage {
+    uint32_t texture;
+    int *pixels;
+    fwtSkylineNode *nodes;
+    int nodeCount, nodeCapacity;
+    bool dirty;
+    uint64_t uploadFrame;
+} fwtAtlasPage;
+
+#define TEXTURE_PACK_MAGIC 0x50545746 // "FWTP"
+#define TEXTURE_PACK_VERSION 1
+#define TEXTURE_PACK_ALIGN 16
+
+typedef struct fwtPackHeader {
+    uint32_t magic, version;
+    uint32_t count;
+    uint32_t bgra; // Pixels were swizzled for FWT_TEXTURE_BGRA
+} fwtPackHeader;
+
+// Entries follow the header sorted by name hash, each entry's mip chain is stored
+// largest first and back to back at `offset` bytes from the start of the pack
+typedef struct fwtPackEntry {
+    uint64_t name;
+    uint64_t offset;
+    uint32_t w, h;
+    uint32_t mipmaps, reserved;
+} fwtPackEntry;
+
+typedef struct fwtTexturePack {
+    void *data;
+    size_t size;
+    const fwtPackEntry *entries;
+    uint32_t count;
+#if defined(FWT_WINDOWS)
+    HANDLE file, mapping;
+#endif
+} fwtTexturePack;
+
+#define COMMAND_CAPTURE_MAGIC 0x43545746 // "FWTC"
+// Captures hold raw command records, so they only replay on the build that wrote them
+#define COMMAND_CAPTURE_VERSION 1
+
+// Followed by `textureCount` fwtCaptureTexture (indexed like state.textures), then the
+// `size` bytes of the command stream. The stream starts 16 byte aligned from the file start
+typedef struct fwtCaptureHeader {
+    uint32_t magic, version;
+    uint32_t textureCount;
+    uint32_t width, height;
+    uint32_t reserved;
+    uint64_t size;
+} fwtCaptureHeader;
+
+typedef struct fwtCaptureTexture {
+    int32_t w, h; // 0 for free slots
+    uint32_t page; // Atlas page slot + 1, 0 if the texture has its own image
+    int32_t x, y;
+} fwtCaptureTexture;
+
+#define INPUT_RECORDING_MAGIC 0x49545746 // "FWTI"
+#define INPUT_RECORDING_VERSION 1
+
+// Followed by fwtRecordedEvent until the end of the file, the last one is a
+// SAPP_EVENTTYPE_INVALID marking the frame the recording stopped on
+typedef struct fwtInputRecordingHeader {
+    uint32_t magic, version;
+    uint32_t eventSize; // sizeof(sapp_event) in the build that recorded it
+    uint32_t reserved;
+    double delta; // state.frameDelta while recording, 0 if frames weren't pinned
+} fwtInputRecordingHeader;
+
+typedef struct fwtRecordedEvent {
+    uint64_t frame; // FrameCallback calls since recording started, the event came before the next one
+    uint64_t timestamp; // stm_now() when it arrived
+    sapp_event event;
+} fwtRecordedEvent;
+
+typedef struct fwtCommandBuffer {
+    unsigned char *data;
+    size_t size, capacity, cursor;
+    uint32_t key;
+    size_t sortSection, sortItem;
+} fwtCommandBuffer;
+
+typedef struct fwtCommandList fwtCommandList;
+typedef struct fwtTextureJob fwtTextureJob;
+
+typedef struct fwtTextureLoader {
+    pthread_t threads[TEXTURE_LOADER_THREADS];
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    bool running;
+    fwtTextureJob *pending, *pendingTail; // guarded by `lock`
+    fwtTextureJob *completed; // lock-free, pushed by the loader threads
+    fwtTextureJob *uploads, *uploadsTail; // main thread only
+} fwtTextureLoader;
+
 typedef struct fwtScene fwtScene;
 typedef struct fwtContext fwtContext;
 
+typedef enum fwtSceneRequestType {
+    fwtScenePreload,
+    fwtSceneAttach,
+    fwtSceneDetach
+} fwtSceneRequestType;
+
+// Applied by the program between frames, `name` must stay valid until then
+typedef struct fwtSceneRequest {
+    fwtSceneRequestType type;
+    const char *name;
+    int order;
+} fwtSceneRequest;
+
+// Written by the program at the start of every frame, read with fwtFrameTiming
+typedef struct fwtFrameTimings {
+    float samples[FRAME_TIMING_SAMPLES]; // Milliseconds between frame starts
+    uint32_t cursor, count;
+    uint64_t missedDeadlines;
+    uint64_t deadline; // stm_now() the limiter is waiting for, 0 to resync
+} fwtFrameTimings;
+
+typedef struct fwtFrameTimingStats {
+    double mean, p99, min, max; // Milliseconds
+    uint64_t missedDeadlines;
+    uint32_t samples;
+} fwtFrameTimingStats;
+
+// Render counters for the last frame, see fwtGetFrameStats
+typedef struct fwtFrameStats {
+    uint32_t commands; // fwt commands replayed
+    uint32_t draws; // fwt draw commands, each one a draw request to sokol_gp
+    uint32_t sgpCommands, maxCommands;
+    uint32_t vertices, maxVertices;
+    uint32_t uniforms, maxUniforms;
+    uint32_t drawCalls; // sg_draw calls left after sokol_gp's batch optimizer
+    uint32_t mergedBatches; // Draws folded into an earlier draw call (or culled off screen)
+    uint32_t textureBinds;
+    sgp_error error; // Anything but SGP_NO_ERROR means draws were dropped this frame
+    uint64_t errorFrames; // Frames that dropped draws since startup
+} fwtFrameStats;
+
 typedef struct fwtState {
     const char *libraryPath;
     void *libraryHandle;
@@ -211,14 +462,39 @@ typedef struct fwtState {
 #else
     FILETIME libraryWriteTime;
 #endif
+    uint64_t libraryChangeTime; // stm_now() of the last change seen by the watcher, 0 when clean
+    uint64_t libraryChecks; // Times ReloadLibrary has touched the filesystem
+    uint64_t prevFrameTime;
+    double tickRate, fixedAccumulator;
+    double targetFPS; // 0 leaves pacing to the swap interval
+    double frameDelta; // Pins every frame's delta (seconds) when > 0, for benchmarks and replays
+    int argc;
+    char **argv;
+    char capturePath[MAX_PATH]; // Set by fwtCaptureFrame, cleared once written
+    fwtFrameTimings frameTimings;
+    fwtFrameStats frameStats;
+    bool statsOverlay;
     fwtContext *libraryContext;
     fwtScene *libraryScene;
     const char *nextScene;
-
-    imap_node_t *textureMap;
-    int textureMapCapacity;
-    int textureMapCount;
-    ezStack commandQueue;
+    fwtSceneRequest sceneRequests[MAX_SCENE_REQUESTS];
+    int sceneRequestCount;
+
+    fwtTexture *textures;
+    fwtTextureSlot *textureSlots;
+    uint32_t textureCount, textureCapacity, textureFreeList;
+    uint32_t texturePendingFree; // Slots freed this frame, only reused once the frame has replayed
+    uint32_t *textureNames; // Open addressed table from a slot's name to its index + 1, see fwtFindTexture
+    uint32_t textureNameCount, textureNameCapacity;
+    fwtTextureLoader textureLoader;
+    fwtAtlasPage *atlasPages;
+    int atlasPageCount;
+    fwtTexturePack texturePack;
+    fwtCommandBuffer commandBuffer;
+    fwtCommandBuffer threadCommandBuffers[MAX_THREAD_COMMAND_BUFFERS];
+    int threadCommandBufferCount;
+    int threadRecorders; // Workers between fwtBeginThreadCommands and fwtEndThreadCommands
+    pthread_t mainThread; // Set at init, the only thread allowed to create or destroy textures
     sg_color clearColor;
 
     bool running;
@@ -247,7 +523,11 @@ typedef struct fwtState {
             float x, y;
         } scroll;
     } mouse;
-    uint32_t modifiers;
+    uint32_t modifiers; // From the last key, char or mouse event, held until the next one
+    // Every event since the last frame in arrival order, handed to `event` and cleared at the end of the frame
+    sapp_event events[MAX_FRAME_EVENTS];
+    int eventCount;
+    uint64_t droppedEvents; // Events that didn't fit in `events` since startup
     const char *dropped[FWT_MAX_DROPPED_FILES];
     int droppedCount;
     char clipboard[FWT_CLIPBOARD_SIZE];
@@ -258,15 +538,105 @@ struct fwtScene {
     void (*deinit)(fwtState*, fwtContext*);
     void (*reload)(fwtState*, fwtContext*);
     void (*unload)(fwtState*, fwtContext*);
-    void (*event)(fwtState*, fwtContext*, fwtEventType);
+    // Called once at the start of a frame with every event since the last one (if there were any)
+    void (*event)(fwtState*, fwtContext*, const sapp_event*, int);
     void (*preframe)(fwtState*, fwtContext*);
+    // Called once a frame with the frame's delta in seconds
     bool (*update)(fwtState*, fwtContext*, float);
+    // Called zero or more times a frame with a fixed delta (1 / tick rate)
     bool (*fixedupdate)(fwtState*, fwtContext*, float);
+    // Called with how far (0-1) the frame is between the last fixed update and the next,
+    // use it to interpolate between the previous and current simulation state
     void (*frame)(fwtState*, fwtContext*, float);
     void (*postframe)(fwtState*, fwtContext*);
+    // Optional, lets a scene's context survive switching to another scene. `serialize` is
+    // called before `deinit` and returns a malloc'd blob, `deserialize` is called instead of
+    // `init` when the scene is swapped back in (returning NULL falls back to `init`)
+    void* (*serialize)(fwtState*, fwtContext*, size_t*);
+    fwtContext* (*deserialize)(fwtState*, const void*, size_t);
 };
 
 EXPORT void fwtSwapToScene(fwtState *state, const char *name);
+// Loads a scene in the background and keeps it resident, fwtSwapToScene to it is then instant
+EXPORT void fwtPreloadScene(fwtState *state, const char *name);
+// Preloads every scene in FWT_SCENES (only MAX_RESIDENT_SCENES stay resident)
+EXPORT void fwtPreloadScenes(fwtState *state);
+// Ticks (and draws) a scene alongside the current one, lower `order` goes first
+EXPORT void fwtAttachScene(fwtState *state, const char *name, int order);
+EXPORT void fwtDetachScene(fwtState *state, const char *name);
+
+EXPORT void fwtSetTickRate(fwtState *state, double hz);
+EXPORT double fwtTickRate(fwtState *state);
+// Writes every command the next frame replays to `path` (see etc/replay-commands.c)
+EXPORT void fwtCaptureFrame(fwtState *state, const char *path);
+
+// Value of a `key=value` command line argument, or `value` if it wasn't passed
+EXPORT const char* fwtArgument(fwtState *state, const char *key, const char *value);
+
+// Caps the frame rate with a sleep + spin wait, 0 disables it (on by default without vsync)
+EXPORT void fwtSetTargetFPS(fwtState *state, double fps);
+EXPORT double fwtTargetFPS(fwtState *state);
+// Mean, 99th percentile and extremes over the last FRAME_TIMING_SAMPLES frames
+EXPORT fwtFrameTimingStats fwtFrameTiming(fwtState *state);
+EXPORT fwtFrameStats fwtGetFrameStats(fwtState *state);
+// Draws sokol_gp queue usage (vertices, commands, uniforms), the batch merge ratio and recent
+// frame times over the top left corner. Bars turn red when a frame dropped draws
+EXPORT bool fwtIsStatsOverlayVisible(fwtState *state);
+EXPORT void fwtToggleStatsOverlay(fwtState *state);
+
+// FWT_PROFILE_SCOPE(name) times the rest of the enclosing block, fwtDumpProfile writes the
+// recorded scopes as Chrome trace_event JSON (open in chrome://tracing or ui.perfetto.dev).
+// Both compile to nothing when FWT_RELEASE is defined
+#if defined(FWT_RELEASE)
+#define FWT_PROFILE_SCOPE(NAME)
+#define fwtDumpProfile(PATH) false
+#else
+// Scopes kept per thread, older ones are overwritten
+#if !defined(PROFILE_EVENTS_PER_THREAD)
+#define PROFILE_EVENTS_PER_THREAD 16384
+#endif
+
+#if !defined(MAX_PROFILE_THREADS)
+#define MAX_PROFILE_THREADS 32
+#endif
+
+#if !defined(PROFILE_NAME_LENGTH)
+#define PROFILE_NAME_LENGTH 48
+#endif
+
+typedef struct fwtProfileZone {
+    const char *name;
+    uint64_t start;
+} fwtProfileZone;
+
+typedef struct fwtProfileEvent {
+    char name[PROFILE_NAME_LENGTH]; // Copied, a scene's strings go away when it's reloaded
+    uint64_t start, end;
+} fwtProfileEvent;
+
+// Single writer (the thread that owns it), `head` counts every event ever written
+typedef struct fwtProfileBuffer {
+    fwtProfileEvent events[PROFILE_EVENTS_PER_THREAD];
+    uint64_t head;
+} fwtProfileBuffer;
+
+typedef struct fwtProfiler {
+    fwtProfileBuffer *buffers[MAX_PROFILE_THREADS];
+    int bufferCount;
+    fwtProfileBuffer* (*threadBuffer)(void); // The calling thread's buffer, registered on first use
+} fwtProfiler;
+
+#define FWT__CONCAT(A, B) A##B
+#define FWT_CONCAT(A, B) FWT__CONCAT(A, B)
+#define FWT_PROFILE_SCOPE(NAME) \
+    fwtProfileZone FWT_CONCAT(fwtProfileZone, __LINE__) __attribute__((cleanup(fwtProfileEnd))) = fwtProfileBegin(NAME)
+
+// Owned by the program, scenes get pointed at it when they're loaded
+EXPORT extern fwtProfiler *fwtActiveProfiler;
+EXPORT fwtProfileZone fwtProfileBegin(const char *name);
+EXPORT void fwtProfileEnd(fwtProfileZone *zone);
+EXPORT bool fwtDumpProfile(const char *path);
+#endif
 
 EXPORT void fwtWindowSize(fwtState *state, int* width, int* height);
 EXPORT int fwtIsWindowFullscreen(fwtState *state);
@@ -286,7 +656,23 @@ EXPORT void fwtMouseScroll(fwtState *state, float *dx, float *dy);
 EXPORT bool fwtTestKeyboardModifiers(fwtState *state, int count, ...);
 
 EXPORT uint64_t fwtFindTexture(fwtState *state, const char *name);
-EXPORT void fwtCreateTexture(fwtState *state, const char *name, ezImage *image);
+EXPORT bool fwtIsTextureValid(fwtState *state, uint64_t texture_id);
+EXPORT uint64_t fwtCreateTexture(fwtState *state, const char *name, ezImage *image);
+EXPORT uint64_t fwtLoadTextureAsync(fwtState *state, const char *name);
+EXPORT uint64_t fwtPackTexture(fwtState *state, const char *name, ezImage *image);
+EXPORT void fwtDestroyTexture(fwtState *state, uint64_t texture_id);
+
+EXPORT void fwtBeginThreadCommands(fwtState *state, uint32_t key);
+EXPORT void fwtEndThreadCommands(fwtState *state);
+
+EXPORT fwtCommandList* fwtBeginCommandList(fwtState *state);
+EXPORT void fwtEndCommandList(fwtState *state);
+EXPORT void fwtSubmitCommandList(fwtState *state, fwtCommandList *list);
+EXPORT void fwtDestroyCommandList(fwtCommandList *list);
+
+EXPORT void fwtBeginSortedDraws(fwtState *state);
+EXPORT void fwtSetLayer(fwtState *state, uint16_t layer);
+EXPORT void fwtEndSortedDraws(fwtState *state);
 
 EXPORT void fwtProject(fwtState* state, float left, float right, float top, float bottom);
 EXPORT void fwtResetProject(fwtState* state);
@@ -299,7 +685,7 @@ EXPORT void fwtRotateAt(fwtState* state, float theta, float x, float y);
 EXPORT void fwtScale(fwtState* state, float sx, float sy);
 EXPORT void fwtScaleAt(fwtState* state, float sx, float sy, float x, float y);
 EXPORT void fwtResetPipeline(fwtState* state);
-EXPORT void fwtSetUniform(fwtState* state, void* data, int size);
+EXPORT void fwtSetUniform(fwtState* state, const void* data, int size);
 EXPORT void fwtResetUniform(fwtState* state);
 EXPORT void fwtSetBlendMode(fwtState* state, sgp_blend_mode blend_mode);
 EXPORT void fwtResetBlendMode(fwtState* state);
@@ -315,17 +701,17 @@ EXPORT void fwtScissor(fwtState* state, int x, int y, int w, int h);
 EXPORT void fwtResetScissor(fwtState* state);
 EXPORT void fwtResetState(fwtState* state);
 EXPORT void fwtClear(fwtState* state);
-EXPORT void fwtDrawPoints(fwtState* state, sgp_point* points, int count);
+EXPORT void fwtDrawPoints(fwtState* state, const sgp_point* points, int count);
 EXPORT void fwtDrawPoint(fwtState* state, float x, float y);
-EXPORT void fwtDrawLines(fwtState* state, sgp_line* lines, int count);
+EXPORT void fwtDrawLines(fwtState* state, const sgp_line* lines, int count);
 EXPORT void fwtDrawLine(fwtState* state, float ax, float ay, float bx, float by);
-EXPORT void fwtDrawLinesStrip(fwtState* state, sgp_point* points, int count);
-EXPORT void fwtDrawFilledTriangles(fwtState* state, sgp_triangle* triangles, int count);
+EXPORT void fwtDrawLinesStrip(fwtState* state, const sgp_point* points, int count);
+EXPORT void fwtDrawFilledTriangles(fwtState* state, const sgp_triangle* triangles, int count);
 EXPORT void fwtDrawFilledTriangle(fwtState* state, float ax, float ay, float bx, float by, float cx, float cy);
-EXPORT void fwtDrawFilledTrianglesStrip(fwtState* state, sgp_point* points, int count);
-EXPORT void fwtDrawFilledRects(fwtState* state, sgp_rect* rects, int count);
+EXPORT void fwtDrawFilledTrianglesStrip(fwtState* state, const sgp_point* points, int count);
+EXPORT void fwtDrawFilledRects(fwtState* state, const sgp_rect* rects, int count);
 EXPORT void fwtDrawFilledRect(fwtState* state, float x, float y, float w, float h);
-EXPORT void fwtDrawTexturedRects(fwtState* state, int channel, sgp_textured_rect* rects, int count);
+EXPORT void fwtDrawTexturedRects(fwtState* state, int channel, const sgp_textured_rect* rects, int count);
 EXPORT void fwtDrawTexturedRect(fwtState* state, int channel, sgp_rect dest_rect, sgp_rect src_rect);
 
 extern fwtState state;